@@ -0,0 +1,289 @@
+/*
+ * cap2rep.c - Turn a raw log written by libmmcapture.so into a
+ *             tracefile for mdriver: text (.rep) by default, or the
+ *             binary format of trace.h with -b.
+ *
+ * Usage: cap2rep [-b] <in.raw> <out>
+ *
+ * The records of all threads are merged by timestamp and replayed in
+ * that order on one thread. Block addresses become trace ids: a new
+ * id for every allocation, kept by realloc and dropped by free. Calls
+ * the trace format cannot express are adapted:
+ *  - frees and reallocs of blocks allocated before the capture began
+ *    (or by memalign and friends) are skipped, or turned into allocs;
+ *  - an address handed out again without a recorded free gets a free
+ *    of its old id first;
+ *  - zero-byte requests become one-byte requests, and realloc(p, 0)
+ *    becomes a free.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "trace.h"
+
+#define MAP_BITS 16 /* log2 of the initial address table size */
+
+/* One request of the trace being built */
+typedef struct {
+    char type;      /* 'a', 'r' or 'f' */
+    unsigned id;
+    uint32_t size;
+} op_t;
+
+/* A live block in the address table; ptr 0 marks an empty slot */
+typedef struct {
+    uint64_t ptr;
+    unsigned id;
+    uint32_t size;
+} slot_t;
+
+static caprec_t *recs;     /* all records of the log */
+static slot_t *slots;      /* open addressing table from addresses to ids */
+static int bits;           /* log2 of the number of slots */
+static unsigned count;     /* live blocks in the table */
+
+static op_t *ops;          /* requests of the trace */
+static unsigned num_ops, max_ops;
+static unsigned num_ids;
+static uint64_t live, max_live;
+
+static void error(char *msg, char *path)
+{
+    fprintf(stderr, "cap2rep: %s %s\n", msg, path);
+    exit(1);
+}
+
+/*
+ * rec_cmp - qsort order of two record indices: by time, then by
+ *    position in the log, which keeps each thread's records in order
+ */
+static int rec_cmp(const void *a, const void *b)
+{
+    uint32_t i = *(const uint32_t *)a, j = *(const uint32_t *)b;
+
+    if (recs[i].ts != recs[j].ts)
+	return (recs[i].ts < recs[j].ts) ? -1 : 1;
+    return (i < j) ? -1 : (i > j);
+}
+
+#define HOME(ptr) ((unsigned)(((ptr) * 0x9e3779b97f4a7c15ull) >> (64 - bits)))
+
+static slot_t *map_find(uint64_t ptr)
+{
+    unsigned mask = (1u << bits) - 1, i;
+
+    for (i = HOME(ptr); slots[i].ptr != 0; i = (i + 1) & mask)
+	if (slots[i].ptr == ptr)
+	    return &slots[i];
+    return NULL;
+}
+
+static void map_init(int b)
+{
+    if ((slots = calloc((size_t)1 << b, sizeof(slot_t))) == NULL)
+	error("out of memory for", "the address table");
+    bits = b;
+    count = 0;
+}
+
+static slot_t *map_insert(uint64_t ptr)
+{
+    slot_t *old = slots;
+    unsigned mask, i, n = 1u << bits;
+
+    if (4 * (count + 1) > 3 * n) {   /* double once 3/4 full */
+	map_init(bits + 1);
+	for (i = 0; i < n; i++)
+	    if (old[i].ptr != 0)
+		*map_insert(old[i].ptr) = old[i];
+	free(old);
+    }
+    mask = (1u << bits) - 1;
+    for (i = HOME(ptr); slots[i].ptr != 0; i = (i + 1) & mask)
+	;
+    slots[i].ptr = ptr;
+    count++;
+    return &slots[i];
+}
+
+/* Backward-shift deletion, as in mdriver's idmap_remove */
+static void map_remove(slot_t *slot)
+{
+    unsigned mask = (1u << bits) - 1;
+    unsigned i = slot - slots, j, home;
+
+    for (j = (i + 1) & mask; slots[j].ptr != 0; j = (j + 1) & mask) {
+	home = HOME(slots[j].ptr);
+	if (((j - home) & mask) >= ((j - i) & mask)) {
+	    slots[i] = slots[j];
+	    i = j;
+	}
+    }
+    slots[i].ptr = 0;
+    count--;
+}
+
+static void add_op(char type, unsigned id, uint64_t size)
+{
+    if (num_ops == max_ops) {
+	max_ops = max_ops ? 2 * max_ops : 4096;
+	if ((ops = realloc(ops, max_ops * sizeof(op_t))) == NULL)
+	    error("out of memory for", "the requests");
+    }
+    ops[num_ops].type = type;
+    ops[num_ops].id = id;
+    ops[num_ops].size = (size == 0) ? 1 : (uint32_t)size;
+    num_ops++;
+}
+
+/* free of a live block */
+static void do_free(slot_t *slot)
+{
+    add_op('f', slot->id, 0);
+    live -= slot->size;
+    map_remove(slot);
+}
+
+/* a new block at ptr */
+static void do_alloc(uint64_t ptr, uint64_t size)
+{
+    slot_t *slot;
+
+    if ((slot = map_find(ptr)) != NULL)
+	do_free(slot);   /* its free was not recorded */
+    slot = map_insert(ptr);
+    slot->id = num_ids++;
+    slot->size = (uint32_t)size;
+    add_op('a', slot->id, size);
+    live += size;
+    max_live = (live > max_live) ? live : max_live;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in, *out;
+    caphdr_t hdr;
+    tracehdr_t thdr;
+    caprec_t *r;
+    slot_t *slot;
+    uint32_t *order;
+    unsigned char buf[TREC_MAX_BYTES], *p;
+    unsigned i, id, nrecs = 0, maxrecs = 0;
+    size_t n;
+    int c, binary = 0;
+
+    while ((c = getopt(argc, argv, "b")) != EOF)
+	if (c == 'b')
+	    binary = 1;
+	else
+	    error("usage: cap2rep [-b] <in.raw> <out>", "");
+    if (argc - optind != 2)
+	error("usage: cap2rep [-b] <in.raw> <out>", "");
+
+    /* Read the whole log */
+    if ((in = fopen(argv[optind], "rb")) == NULL)
+	error("could not open", argv[optind]);
+    if ((fread(&hdr, sizeof(hdr), 1, in) != 1) || (hdr.magic != CAP_MAGIC) ||
+	(hdr.version != CAP_VERSION))
+	error("not a capture log:", argv[optind]);
+    do {
+	if (nrecs == maxrecs) {
+	    maxrecs = maxrecs ? 2 * maxrecs : 65536;
+	    if ((recs = realloc(recs, maxrecs * sizeof(caprec_t))) == NULL)
+		error("out of memory reading", argv[optind]);
+	}
+	n = fread(&recs[nrecs], sizeof(caprec_t), maxrecs - nrecs, in);
+	nrecs += n;
+    } while (n > 0);
+    fclose(in);
+
+    /* Merge the threads by time */
+    if ((order = malloc((nrecs + 1) * sizeof(uint32_t))) == NULL)
+	error("out of memory sorting", argv[optind]);
+    for (i = 0; i < nrecs; i++)
+	order[i] = i;
+    qsort(order, nrecs, sizeof(uint32_t), rec_cmp);
+
+    /* Give every block an id */
+    map_init(MAP_BITS);
+    for (i = 0; i < nrecs; i++) {
+	r = &recs[order[i]];
+	switch (r->type) {
+	case CAP_MALLOC:
+	case CAP_CALLOC:
+	    if (r->result != 0)
+		do_alloc(r->result, r->size);
+	    break;
+	case CAP_REALLOC:
+	    slot = (r->ptr != 0) ? map_find(r->ptr) : NULL;
+	    if ((r->size == 0) && (r->ptr != 0)) {
+		if (slot != NULL)
+		    do_free(slot);
+	    }
+	    else if (r->result == 0)
+		;   /* failed, the old block is untouched */
+	    else if (slot == NULL)
+		do_alloc(r->result, r->size);
+	    else {
+		id = slot->id;
+		live += r->size - slot->size;
+		max_live = (live > max_live) ? live : max_live;
+		map_remove(slot);
+		if ((slot = map_find(r->result)) != NULL)
+		    do_free(slot);
+		slot = map_insert(r->result);
+		slot->id = id;
+		slot->size = (uint32_t)r->size;
+		add_op('r', id, r->size);
+	    }
+	    break;
+	case CAP_FREE:
+	    if ((slot = map_find(r->ptr)) != NULL)
+		do_free(slot);
+	    break;
+	}
+    }
+    if (num_ops == 0)
+	error("no requests in", argv[optind]);
+    if (num_ids > TREC_MAX_INDEX + 1u)
+	error("too many blocks in", argv[optind]);
+
+    /* Write the trace; the suggested heap size is the peak live bytes */
+    if ((out = fopen(argv[optind + 1], binary ? "wb" : "w")) == NULL)
+	error("could not create", argv[optind + 1]);
+    if (binary) {
+	memset(&thdr, 0, sizeof(thdr));
+	thdr.magic = TRACE_MAGIC;
+	thdr.version = TRACE_VERSION;
+	thdr.sugg_heapsize = (uint32_t)max_live;
+	thdr.num_ids = num_ids;
+	thdr.num_ops = num_ops;
+	thdr.weight = 1;
+	fwrite(&thdr, sizeof(thdr), 1, out);
+	for (i = 0; i < num_ops; i++) {
+	    p = put_varint(buf, (ops[i].id << 2) |
+			   ((ops[i].type == 'a') ? TREC_ALLOC :
+			    (ops[i].type == 'f') ? TREC_FREE : TREC_REALLOC));
+	    if (ops[i].type != 'f')
+		p = put_varint(p, ops[i].size);
+	    fwrite(buf, 1, p - buf, out);
+	    thdr.data_bytes += p - buf;
+	}
+	rewind(out);
+	fwrite(&thdr, sizeof(thdr), 1, out);
+    }
+    else {
+	fprintf(out, "%u\n%u\n%u\n%d\n", (unsigned)max_live, num_ids, num_ops, 1);
+	for (i = 0; i < num_ops; i++)
+	    if (ops[i].type == 'f')
+		fprintf(out, "f %u\n", ops[i].id);
+	    else
+		fprintf(out, "%c %u %u\n", ops[i].type, ops[i].id, ops[i].size);
+    }
+    if (fclose(out) != 0)
+	error("could not write", argv[optind + 1]);
+    return 0;
+}
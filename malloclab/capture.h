@@ -0,0 +1,44 @@
+#ifndef __CAPTURE_H_
+#define __CAPTURE_H_
+
+/*
+ * capture.h - raw log format written by the libmmcapture.so shim
+ *             and read by cap2rep
+ *
+ * A raw log is a caphdr_t followed by caprec_t records, one per
+ * malloc, calloc, realloc or free made by the captured process. Each
+ * thread's records are in order, but the threads' records are
+ * interleaved in the order the shim flushed them; cap2rep sorts them
+ * by timestamp. Fields are stored in host byte order.
+ */
+#include <stdint.h>
+
+#define CAP_MAGIC   0x50434c4d  /* "MLCP" */
+#define CAP_VERSION 1
+
+/* Record types */
+#define CAP_MALLOC  0
+#define CAP_CALLOC  1
+#define CAP_REALLOC 2
+#define CAP_FREE    3
+
+typedef struct {
+    uint32_t magic;    /* CAP_MAGIC */
+    uint32_t version;  /* CAP_VERSION */
+} caphdr_t;
+
+/*
+ * Allocations are stamped after the real call returns and frees
+ * before it is made, so a block freed by one thread and handed out
+ * again to another is always freed first in timestamp order.
+ */
+typedef struct {
+    uint64_t ts;       /* CLOCK_MONOTONIC time in ns */
+    uint64_t ptr;      /* block freed or resized, 0 for malloc/calloc */
+    uint64_t result;   /* block returned, 0 for free or a failed call */
+    uint64_t size;     /* bytes requested (nmemb * size for calloc) */
+    uint32_t tid;      /* kernel thread id of the caller */
+    uint32_t type;     /* CAP_MALLOC ... CAP_FREE */
+} caprec_t;
+
+#endif /* __CAPTURE_H_ */
@@ -1,6 +1,6 @@
 /* 
- * clock.c - Routines for using the cycle counters on x86, 
- *           Alpha, and Sparc boxes.
+ * clock.c - Routines for using the cycle counters on x86, x86-64,
+ *           AArch64, Alpha, and Sparc boxes.
  * 
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
@@ -10,13 +10,17 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/times.h>
+#include <time.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
 #include "clock.h"
 
 
 /******************************************************* 
  * Machine dependent functions 
  *
- * Note: the constants __i386__ and  __alpha
+ * Note: the constants __i386__, __x86_64__, __aarch64__ and __alpha
  * are set by GCC when it calls the C preprocessor
  * You can verify this for yourself using gcc -v.
  *******************************************************/
@@ -71,6 +75,83 @@ double get_counter()
 }
 /* $end x86cyclecounter */
 
+#elif defined(__x86_64__)
+/*****************************************************************
+ * x86-64 versions of start_counter() and get_counter()
+ *
+ * The time stamp counter is read with rdtsc behind an lfence at the
+ * start, so earlier instructions cannot leak into the interval, and
+ * with rdtscp followed by an lfence at the end, so the measured code
+ * has finished and later code has not begun. On CPUs with an
+ * invariant TSC the counter ticks at a constant rate whatever the
+ * core clock does, and mhz() returns that rate.
+ *****************************************************************/
+
+static unsigned long long cyc_start = 0;
+
+/* Read the time stamp counter after all earlier instructions */
+static unsigned long long access_counter_start(void)
+{
+    unsigned hi, lo;
+
+    asm volatile("lfence; rdtsc" : "=a" (lo), "=d" (hi) : : "memory");
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+/* Read the time stamp counter before any later instructions */
+static unsigned long long access_counter_end(void)
+{
+    unsigned hi, lo, aux;
+
+    asm volatile("rdtscp; lfence" : "=a" (lo), "=d" (hi), "=c" (aux) : : "memory");
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+/* Record the current value of the cycle counter. */
+void start_counter()
+{
+    cyc_start = access_counter_start();
+}
+
+/* Return the number of cycles since the last call to start_counter. */
+double get_counter()
+{
+    return (double)(access_counter_end() - cyc_start);
+}
+
+#elif defined(__aarch64__)
+/*****************************************************************
+ * AArch64 versions of start_counter() and get_counter()
+ *
+ * User code cannot read the core's cycle counter (PMCCNTR_EL0) unless
+ * the kernel allows it, so these use the virtual count of the generic
+ * timer, cntvct_el0. It ticks at a fixed rate (cntfrq_el0, typically
+ * tens of MHz to 1 GHz) that mhz() measures like a clock rate. The isb
+ * keeps the read from being done ahead of earlier instructions.
+ *****************************************************************/
+
+static unsigned long long cyc_start = 0;
+
+static unsigned long long access_counter(void)
+{
+    unsigned long long v;
+
+    asm volatile("isb; mrs %0, cntvct_el0" : "=r" (v) : : "memory");
+    return v;
+}
+
+/* Record the current value of the counter. */
+void start_counter()
+{
+    cyc_start = access_counter();
+}
+
+/* Return the number of counter ticks since the last call to start_counter. */
+double get_counter()
+{
+    return (double)(access_counter() - cyc_start);
+}
+
 #elif defined(__alpha)
 
 /****************************************************
@@ -163,6 +244,43 @@ double get_counter()
 
 
 
+/*
+ * read_counter - Raw value of the cheapest counter there is, for timing
+ *    single calls: the cycle counter on x86, nanoseconds elsewhere.
+ *    Unlike get_counter it keeps no state, so it can be read in any
+ *    order and from any thread.
+ */
+unsigned long long read_counter()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned hi, lo;
+
+    asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((unsigned long long)hi << 32) | lo;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+#if defined(__x86_64__)
+/*
+ * tsc_invariant - Nonzero if the time stamp counter runs at a constant
+ *    rate in every P-, C- and T-state (CPUID 0x80000007, EDX bit 8)
+ */
+static int tsc_invariant(void)
+{
+    unsigned eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+	return 0;
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx >> 8) & 1;
+}
+#endif
+
 /*******************************
  * Machine-independent functions
  ******************************/
@@ -184,13 +302,32 @@ double ovhd()
 /* while sleeping for sleeptime seconds */
 double mhz_full(int verbose, int sleeptime)
 {
-    double rate;
-
+    double rate, secs = sleeptime;
+#ifdef CLOCK_MONOTONIC_RAW
+    struct timespec t0, t1;
+
+    /* 
+     * sleep() may run long, so divide by the time that actually went
+     * by on the raw monotonic clock, which NTP does not slew
+     */
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t0);
     start_counter();
     sleep(sleeptime);
-    rate = get_counter() / (1e6*sleeptime);
+    rate = get_counter();
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+    secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    rate /= 1e6*secs;
+#else
+    start_counter();
+    sleep(sleeptime);
+    rate = get_counter() / (1e6*secs);
+#endif
     if (verbose) 
 	printf("Processor clock rate ~= %.1f MHz\n", rate);
+#if defined(__x86_64__)
+    if (verbose && !tsc_invariant())
+	printf("Warning: no invariant TSC, cycle counts follow the core clock\n");
+#endif
     return rate;
 }
 /* $end mhz */
@@ -6,6 +6,9 @@ void start_counter();
 /* Get # cycles since counter started */
 double get_counter();
 
+/* Raw counter for timing single calls (cycles on x86, else ns) */
+unsigned long long read_counter();
+
 /* Measure overhead for counter */
 double ovhd();
 
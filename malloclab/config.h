@@ -53,20 +53,54 @@
 #define UTIL_WEIGHT .60
 
 /* 
- * Alignment requirement in bytes (either 4 or 8) 
+ * Alignment requirement in bytes: 8 in 32-bit builds and 16 in 64-bit
+ * builds. Payloads and block sizes are multiples of it; the width of
+ * headers and footers is up to each mm package
  */
+#if defined(__LP64__) || defined(_LP64)
+#define ALIGNMENT 16
+#else
 #define ALIGNMENT 8  
+#endif
 
 /* 
- * Maximum heap size in bytes 
+ * Default maximum heap size in bytes. It can be changed at runtime with
+ * mem_setmax() (mdriver -m) up to MAX_HEAP_LIMIT.
  */
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
+#define MAX_HEAP_LIMIT (1<<30) /* 1 GB */
+
+/*
+ * Set USE_MMAP_HEAP to "1" to have memlib reserve the maximum heap size
+ * as address space with mmap and commit pages only as the brk advances,
+ * instead of malloc'ing the whole heap up front.
+ */
+#define USE_MMAP_HEAP 1
+#define COMMIT_CHUNK (1<<16)   /* bytes committed at a time (page multiple) */
+
+/*
+ * Free space given back to the memory system: a free block at the end
+ * of the heap at least TRIM_THRESHOLD bytes large lowers the brk, and
+ * the interior pages of a free block elsewhere in the heap at least
+ * DECOMMIT_THRESHOLD bytes large are decommitted.
+ */
+#define TRIM_THRESHOLD     (1<<20)  /* 1 MB */
+#define DECOMMIT_THRESHOLD (1<<21)  /* 2 MB */
+
+/*
+ * Requests of at least MMAP_THRESHOLD bytes get a mapping of their own
+ * from mem_map instead of a block in the heap, so realloc can move them
+ * with mem_remap and free returns them at once. Mapped bytes count
+ * towards the heap size and its limit.
+ */
+#define MMAP_THRESHOLD     (1<<17)  /* 128 KB */
 
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
-#define USE_FCYC   0   /* cycle counter w/K-best scheme (x86 & Alpha only) */
+#define USE_FCYC   0   /* cycle counter w/K-best scheme (x86, x86-64, AArch64 & Alpha) */
 #define USE_ITIMER 0   /* interval timer (any Unix box) */
-#define USE_GETTOD 1   /* gettimeofday (any Unix box) */
+#define USE_GETTOD 0   /* gettimeofday (any Unix box) */
+#define USE_CLOCK  1   /* clock_gettime, run until the timing converges */
 
 #endif /* __CONFIG_H */
@@ -36,6 +36,9 @@ void init_fsecs(void)
 #elif USE_GETTOD
     if (verbose)
 	printf("Measuring performance with gettimeofday().\n");
+#elif USE_CLOCK
+    if (verbose)
+	printf("Measuring performance with clock_gettime() until convergence.\n");
 #endif
 }
 
@@ -44,6 +47,17 @@ void init_fsecs(void)
  */
 double fsecs(fsecs_test_funct f, void *argp) 
 {
+    return fsecs_full(f, argp, NULL);
+}
+
+/*
+ * fsecs_full - Return the running time of a function f (in seconds),
+ *    and the spread of the timed runs if the timer measures one
+ */
+double fsecs_full(fsecs_test_funct f, void *argp, ftimer_stats_t *stats) 
+{
+    if (stats)
+	stats->runs = 0;
 #if USE_FCYC
     double cycles = fcyc(f, argp);
     return cycles/(Mhz*1e6);
@@ -51,6 +65,8 @@ double fsecs(fsecs_test_funct f, void *argp)
     return ftimer_itimer(f, argp, 10);
 #elif USE_GETTOD
     return ftimer_gettod(f, argp, 10);
+#elif USE_CLOCK
+    return ftimer_clock(f, argp, stats);
 #endif 
 }
 
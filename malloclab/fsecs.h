@@ -1,4 +1,10 @@
+#include "ftimer.h"
+
 typedef void (*fsecs_test_funct)(void *);
 
 void init_fsecs(void);
 double fsecs(fsecs_test_funct f, void *argp);
+
+/* fsecs that also stores the spread of the runs in *stats (stats->runs 
+   is 0 unless the timer measures one) */
+double fsecs_full(fsecs_test_funct f, void *argp, ftimer_stats_t *stats);
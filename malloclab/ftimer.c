@@ -7,11 +7,24 @@
  * Function timers that estimate the running time (in seconds) of a function f.
  *    ftimer_itimer: version that uses the interval timer
  *    ftimer_gettod: version that uses gettimeofday
+ *    ftimer_clock: version that uses clock_gettime and runs f until
+ *                  the mean has converged
  */
 #include <stdio.h>
+#include <math.h>
+#include <time.h>
 #include <sys/time.h>
 #include "ftimer.h"
 
+/* Parameters of ftimer_clock */
+#define FT_MIN_RUNS 5       /* timed runs before testing for convergence */
+#define FT_MAX_RUNS 200     /* give up converging after this many runs */
+#define FT_MAX_SECS 1.0     /* ... or after this much time on one function */
+#define FT_EPSILON  0.01    /* wanted 95% confidence half-width / mean */
+#define FT_Z        1.96    /* normal quantile of a 95% confidence interval */
+#define FT_K        3       /* ... or until the FT_K fastest runs are within 
+			       FT_EPSILON of each other, as in fcyc */
+
 /* function prototypes */
 static void init_etime(void);
 static double get_etime(void);
@@ -53,6 +66,59 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
 }
 
 
+/*
+ * ftimer_clock - Use the monotonic clock to estimate the running time
+ * of f(argp). After one untimed warm-up run, runs are timed until the
+ * 95% confidence interval of their mean is within FT_EPSILON of the 
+ * mean or the FT_K fastest runs agree to within FT_EPSILON, giving up
+ * after FT_MAX_RUNS runs or FT_MAX_SECS seconds. Interrupts and other
+ * processes only ever add time, so like fcyc this returns the fastest
+ * run; the mean and standard deviation go to *stats.
+ */
+double ftimer_clock(ftimer_test_funct f, void *argp, ftimer_stats_t *stats)
+{
+    struct timespec stv, etv;
+    double t, delta, mean = 0, m2 = 0, total = 0;
+    double best[FT_K];   /* fastest runs so far, in increasing order */
+    int i, n = 0;
+
+    f(argp); /* warm up the caches and the heap */
+    while (n < FT_MAX_RUNS) {
+	clock_gettime(CLOCK_MONOTONIC, &stv);
+	f(argp);
+	clock_gettime(CLOCK_MONOTONIC, &etv);
+	t = (etv.tv_sec - stv.tv_sec) + 1E-9*(etv.tv_nsec - stv.tv_nsec);
+
+	/* Welford's running mean and sum of squared deviations */
+	n++;
+	delta = t - mean;
+	mean += delta / n;
+	m2 += delta * (t - mean);
+	total += t;
+
+	/* Insert t into the FT_K fastest runs */
+	for (i = (n <= FT_K) ? n - 1 : FT_K; (i > 0) && (best[i-1] > t); i--)
+	    if (i < FT_K)
+		best[i] = best[i-1];
+	if (i < FT_K)
+	    best[i] = t;
+
+	/* Converged once z * stddev / sqrt(n) <= epsilon * mean */
+	if ((n >= FT_MIN_RUNS) && 
+	    ((FT_Z * FT_Z * m2 / (n - 1) / n <= FT_EPSILON * FT_EPSILON * mean * mean) ||
+	     (best[FT_K-1] <= (1 + FT_EPSILON) * best[0]) ||
+	     (total >= FT_MAX_SECS)))
+	    break;
+    }
+    if (stats) {
+	stats->runs = n;
+	stats->mean = mean;
+	stats->stddev = sqrt(m2 / (n - 1));
+	stats->min = best[0];
+    }
+    return best[0];
+}
+
 /*
  * Routines for manipulating the Unix interval timer
  */
@@ -1,8 +1,19 @@
+#ifndef __FTIMER_H_
+#define __FTIMER_H_
+
 /* 
  * Function timers 
  */
 typedef void (*ftimer_test_funct)(void *); 
 
+/* Spread of the runs timed by ftimer_clock */
+typedef struct {
+    int runs;       /* number of timed runs, 0 if no spread was measured */
+    double mean;    /* mean running time (secs) */
+    double stddev;  /* sample standard deviation (secs) */
+    double min;     /* fastest run (secs) */
+} ftimer_stats_t;
+
 /* Estimate the running time of f(argp) using the Unix interval timer.
    Return the average of n runs */
 double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
@@ -12,3 +23,10 @@ double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
    Return the average of n runs */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n);
 
+/* Estimate the running time of f(argp) using clock_gettime(CLOCK_MONOTONIC),
+   timing runs until the estimate has converged. Return the fastest run
+   and, if stats is not NULL, store the spread of the runs there */
+double ftimer_clock(ftimer_test_funct f, void *argp, ftimer_stats_t *stats);
+
+#endif /* __FTIMER_H_ */
+
@@ -15,11 +15,26 @@
 #include <assert.h>
 #include <float.h>
 #include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "clock.h"
 #include "config.h"
+#include "trace.h"
+#ifdef MM_ALL
+#include "mmall.h"
+#endif
 
 /**********************
  * Constants and macros
@@ -29,9 +44,36 @@
 #define MAXLINE     1024 /* max string size */
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+#define RANGE_CHUNK 4096 /* range records carved from the pool at a time */
+
+/* Multithreaded replay (-j) */
+#define MAXTHREADS    64 /* max number of replay threads */
+#define JREPS          5 /* runs per thread count, the fastest is reported */
+
+/* Latency histograms (-p) */
+#define HIST_SUB_BITS  5 /* 32 sub-buckets per power of two, ~3% error */
+#define HIST_SUBS      (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS   ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+#define LAT_RUNS       5 /* timed replays of each trace, after a warm-up */
+#if defined(__i386__) || defined(__x86_64__)
+#define LAT_UNIT   "cycles" /* unit of read_counter */
+#else
+#define LAT_UNIT   "ns"
+#endif
+
+/* Worker processes (-w) */
+#define MAXWORKERS    64 /* max number of traces evaluated at once */
+
+/* Hardware performance counters (-e) */
+#define PERF_RUNS      5 /* counted replays of each trace, after a warm-up */
+#define NCOUNTERS      6 /* events in counter_events[] */
+
+/* Streaming replay (-s) */
+#define STREAM_CHUNK 65536 /* requests in each of the two read buffers */
+#define IDMAP_BITS      10 /* log2 of the initial id hash table size */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
+#define IS_ALIGNED(p)  ((((size_t)(p)) % ALIGNMENT) == 0)
 
 /****************************** 
  * The key compound data types 
@@ -41,9 +83,17 @@
 typedef struct range_t {
     char *lo;              /* low payload address */
     char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
+    struct range_t *left;  /* payloads at lower addresses */
+    struct range_t *right; /* payloads at higher addresses (pool free link) */
 } range_t;
 
+/* A chunk of the pool that range records are carved from */
+typedef struct range_chunk_t {
+    struct range_chunk_t *next;  /* previously allocated chunk */
+    int used;                    /* records handed out from this chunk */
+    range_t nodes[RANGE_CHUNK];
+} range_chunk_t;
+
 /* Characterizes a single trace operation (allocator request) */
 typedef struct {
     enum {ALLOC, FREE, REALLOC} type; /* type of request */
@@ -72,6 +122,71 @@ typedef struct {
     range_t *ranges;
 } speed_t;
 
+/* 
+ * Log-bucketed (HDR-style) histogram of latencies: values below 
+ * HIST_SUBS have a bucket each, and every power of two above that is
+ * split into HIST_SUBS buckets of equal width.
+ */
+typedef struct {
+    unsigned long long count;   /* samples recorded */
+    unsigned long long max;     /* largest sample */
+    unsigned buckets[HIST_BUCKETS];
+} hist_t;
+
+/* A hardware event counted with perf_event_open (-e) */
+typedef struct {
+    char *name;                 /* column heading, per request */
+    unsigned type;              /* perf_event_attr type and config */
+    unsigned long long config;
+} counter_t;
+
+/* One of the two buffers the streaming reader fills in turn */
+typedef struct {
+    traceop_t ops[STREAM_CHUNK]; /* requests read into this buffer */
+    int count;                   /* number of requests in ops */
+    int full;                    /* set by the reader, cleared by the replayer */
+} opbuf_t;
+
+/* State shared by the streaming reader thread and the replayer */
+typedef struct {
+    char *path;                  /* tracefile being streamed */
+    FILE *file;                  /* text tracefile, or ... */
+    void *map;                   /* ... mapping of a binary tracefile */
+    size_t maplen;               /* bytes mapped */
+    const unsigned char *p;      /* next binary record to decode */
+    const unsigned char *end;    /* end of the binary records */
+    size_t dropped;              /* bytes of the mapping already dropped */
+    unsigned num_ids;            /* ids in the tracefile header */
+    unsigned num_ops;            /* requests in the tracefile header */
+    unsigned read_ops;           /* requests read so far */
+    opbuf_t buf[2];              /* filled and replayed alternately */
+    pthread_mutex_t lock;        /* protects buf[].full */
+    pthread_cond_t cond;         /* signals a change of buf[].full */
+} stream_t;
+
+/* A live block in the id hash table of the streaming replay */
+typedef struct {
+    int id;                      /* trace id, or -1 if the slot is empty */
+    int size;                    /* payload size requested */
+    char *ptr;                   /* payload returned by mm */
+} idslot_t;
+
+/* Open addressing hash table from ids to live blocks */
+typedef struct {
+    idslot_t *slots;             /* 1 << bits slots */
+    int bits;                    /* log2 of the number of slots */
+    unsigned count;              /* live ids in the table */
+} idmap_t;
+
+/* Holds the params and result of one replay thread in -j mode */
+typedef struct {
+    trace_t *trace;            /* trace shared by all threads (read only) */
+    char **blocks;             /* this thread's block for each id */
+    pthread_barrier_t *start;  /* releases all threads at once */
+    double start_secs;         /* when this thread started replaying */
+    double end_secs;           /* when this thread was done */
+} replay_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
     /* defined for both libc malloc and student malloc package (mm.c) */
@@ -81,14 +196,31 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    size_t peak;     /* heap high water mark in bytes */
+    size_t heap;     /* heap size in bytes after the trace */
+
+    ftimer_stats_t timing; /* spread of the timed runs, if timing.runs > 0 */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+/* What a worker process sends back about its trace (-w) */
+typedef struct {
+    stats_t stats;
+    int errors;      /* errors the worker found in the trace */
+} result_t;
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
+static int stream = 0;  /* If set, stream each trace through mm once (-s) */
+static int latency = 0; /* If set, print latency percentiles (-p) */
+static int counters = 0;/* If set, print hardware event counts (-e) */
+static int nthreads = 0;/* If set, also replay with this many threads (-j) */
+static int workers = 0; /* If set, evaluate this many traces at once (-w) */
+static range_chunk_t *range_pool = NULL; /* range record chunks, newest first */
+static range_t *range_free = NULL;       /* range records given back to the pool */
 static int errors = 0;  /* number of errs found when running student malloc */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
@@ -105,14 +237,19 @@ static char *default_tracefiles[] = {
  * Function prototypes 
  *********************/
 
-/* these functions manipulate range lists */
+/* these functions manipulate range trees */
 static int add_range(range_t **ranges, char *lo, int size, 
 		     int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
+static range_t *new_range(void);
+static void free_range(range_t *p);
+static range_t *splay_range(range_t *t, char *lo);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
+static int read_trace_bin(trace_t *trace, char *path);
+static void alloc_trace(trace_t *trace);
 static void free_trace(trace_t *trace);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
@@ -125,6 +262,48 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
 
+/* Routines for evaluating a whole mm package, or all of them (-b) */
+static double eval_mm_package(char *tracedir, char **tracefiles, 
+			      int num_tracefiles, stats_t *mm_stats,
+			      int *numcorrect);
+static void eval_mm_trace(char *tracedir, char *filename, int tracenum, 
+			  stats_t *stats);
+static void eval_mm_workers(char *tracedir, char **tracefiles, 
+			    int num_tracefiles, stats_t *mm_stats);
+#ifdef MM_ALL
+static void eval_mm_all(char *tracedir, char **tracefiles, 
+			int num_tracefiles, stats_t *libc_stats);
+#endif
+
+/* Routines for evaluating how a thread-safe mm package scales (-j) */
+static void eval_mm_threads(char *tracedir, char **tracefiles, 
+			    int num_tracefiles, int nthreads);
+static double eval_mm_parallel(trace_t *trace, int nthreads, double *thread_secs);
+static void *replay_thread(void *ptr);
+static double now_secs(void);
+
+/* Routines for measuring per-request latencies (-p) */
+static void eval_mm_latency(char *tracedir, char **tracefiles, 
+			    int num_tracefiles);
+static void hist_add(hist_t *h, unsigned long long v);
+static unsigned long long hist_percentile(hist_t *h, double pct);
+
+/* Routines for counting hardware events (-e) */
+static void eval_mm_counters(char *tracedir, char **tracefiles, 
+			     int num_tracefiles);
+static int counter_open(counter_t *ev);
+static double counter_read(int fd);
+
+/* Routines for replaying a trace without reading all of it first (-s) */
+static void eval_mm_stream(char *tracedir, char *filename, int tracenum, 
+			   stats_t *stats);
+static void *stream_reader(void *ptr);
+static int stream_fill(stream_t *s, traceop_t *ops);
+static void idmap_init(idmap_t *m, int bits);
+static idslot_t *idmap_find(idmap_t *m, int id);
+static idslot_t *idmap_insert(idmap_t *m, int id);
+static void idmap_remove(idmap_t *m, idslot_t *slot);
+
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
 static void usage(void);
@@ -142,7 +321,6 @@ int main(int argc, char **argv)
     char **tracefiles = NULL;  /* null-terminated array of trace file names */
     int num_tracefiles = 0;    /* the number of traces in that array */
     trace_t *trace = NULL;     /* stores a single trace file in memory */
-    range_t *ranges = NULL;    /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
     speed_t speed_params;      /* input parameters to the xx_speed routines */ 
@@ -150,15 +328,20 @@ int main(int argc, char **argv)
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int heap_set = 0;    /* If set, the heap limit was given with -m */
 
-    /* temporaries used to compute the performance index */
-    double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
+#ifdef MM_ALL
+    char *package = "all"; /* mm package to run, or all of them (-b) */
+#endif
+
+    /* the performance index and number of traces run correctly */
+    double perfindex;
     int numcorrect;
     
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:m:j:b:w:hvVgalspe")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -178,12 +361,54 @@ int main(int argc, char **argv)
 	    if (tracedir[strlen(tracedir)-1] != '/') 
 		strcat(tracedir, "/"); /* path always ends with "/" */
 	    break;
+	case 'm': /* Maximum heap size in MB */
+	    if (mem_setmax((size_t)atoi(optarg) << 20) < 0) {
+		fprintf(stderr, "ERROR: heap size must be 1 to %d MB\n", MAX_HEAP_LIMIT >> 20);
+		exit(1);
+	    }
+	    heap_set = 1;
+	    break;
+	case 'j': /* Number of threads for the multithreaded replay */
+	    nthreads = atoi(optarg);
+	    if ((nthreads < 1) || (nthreads > MAXTHREADS)) {
+		fprintf(stderr, "ERROR: number of threads must be 1 to %d\n", MAXTHREADS);
+		exit(1);
+	    }
+	    break;
+	case 'w': /* Number of traces to evaluate at once */
+	    workers = atoi(optarg);
+	    if ((workers < 1) || (workers > MAXWORKERS)) {
+		fprintf(stderr, "ERROR: number of workers must be 1 to %d\n", MAXWORKERS);
+		exit(1);
+	    }
+	    break;
+	case 'b': /* Which mm package to run (mdriver-all only) */
+#ifdef MM_ALL
+	    package = optarg;
+	    if (strcmp(package, "all") && (mm_select(package) < 0)) {
+		fprintf(stderr, "ERROR: no mm package called %s\n", package);
+		exit(1);
+	    }
+	    break;
+#else
+	    fprintf(stderr, "ERROR: -b needs mdriver-all\n");
+	    exit(1);
+#endif
         case 'a': /* Don't check team structure */
             team_check = 0;
             break;
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 's': /* Stream the traces instead of reading them first */
+            stream = 1;
+            break;
+        case 'p': /* Print latency percentiles of each request type */
+            latency = 1;
+            break;
+        case 'e': /* Print hardware event counts of each trace */
+            counters = 1;
+            break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -199,6 +424,22 @@ int main(int argc, char **argv)
         }
     }
 	
+#ifdef MM_ALL
+    /* All packages are compared with libc; the team is the first's */
+    if (!strcmp(package, "all")) {
+	run_libc = 1;
+	mm_select(mm_packages[0].name);
+	team.teamname = "all mm packages";
+    }
+    else
+#endif
+    /* Only a thread-safe package can be replayed on many threads */
+    if ((nthreads > 0) && !team.thread_safe) {
+	fprintf(stderr, "ERROR: %s is not thread-safe, -j needs one that is\n",
+		team.teamname);
+	exit(1);
+    }
+
     /* 
      * Check and print team info 
      */
@@ -235,6 +476,11 @@ int main(int argc, char **argv)
 	printf("Using default tracefiles in %s\n", tracedir);
     }
 
+    /* Each replay thread needs a heap of its own size */
+    if ((nthreads > 0) && !heap_set) 
+	mem_setmax(((size_t)MAX_HEAP * nthreads < MAX_HEAP_LIMIT) ? 
+		   (size_t)MAX_HEAP * nthreads : MAX_HEAP_LIMIT);
+
     /* Initialize the timing package */
     init_fsecs();
 
@@ -261,7 +507,8 @@ int main(int argc, char **argv)
 		speed_params.trace = trace;
 		if (verbose > 1)
 		    printf("and performance.\n");
-		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+		libc_stats[i].secs = fsecs_full(eval_libc_speed, &speed_params, 
+						&libc_stats[i].timing);
 	    }
 	    free_trace(trace);
 	}
@@ -273,40 +520,57 @@ int main(int argc, char **argv)
 	}
     }
 
+    /* Initialize the simulated memory system in memlib.c */
+    mem_init(); 
+
+#ifdef MM_ALL
+    /* Evaluate every package and compare them */
+    if (!strcmp(package, "all")) {
+	eval_mm_all(tracedir, tracefiles, num_tracefiles, libc_stats);
+	exit(0);
+    }
+#endif
+
     /*
      * Always run and evaluate the student's mm package
      */
-    if (verbose > 1)
-	printf("\nTesting mm malloc\n");
-
     /* Allocate the mm stats array, with one stats_t struct per tracefile */
     mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
     if (mm_stats == NULL)
 	unix_error("mm_stats calloc in main failed");
-    
-    /* Initialize the simulated memory system in memlib.c */
-    mem_init(); 
+    perfindex = eval_mm_package(tracedir, tracefiles, num_tracefiles, 
+				mm_stats, &numcorrect);
 
-    /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i=0; i < num_tracefiles; i++) {
-	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
-	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-	}
-	free_trace(trace);
+    if (autograder) {
+	printf("correct:%d\n", numcorrect);
+	printf("perfidx:%.0f\n", perfindex);
     }
 
+    exit(0);
+}
+
+/*
+ * eval_mm_package - Evaluates the mm package on every trace, filling
+ *    in mm_stats, prints the optional reports asked for on the command
+ *    line and returns the performance index
+ */
+static double eval_mm_package(char *tracedir, char **tracefiles, 
+			      int num_tracefiles, stats_t *mm_stats,
+			      int *numcorrect)
+{
+    int i;
+    double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
+
+    if (verbose > 1)
+	printf("\nTesting mm malloc\n");
+
+    /* Evaluate student's mm malloc package using the K-best scheme */
+    if (workers > 0)
+	eval_mm_workers(tracedir, tracefiles, num_tracefiles, mm_stats);
+    else
+	for (i=0; i < num_tracefiles; i++)
+	    eval_mm_trace(tracedir, tracefiles[i], i, &mm_stats[i]);
+
     /* Display the mm results in a compact table */
     if (verbose) {
 	printf("\nResults for mm malloc:\n");
@@ -314,19 +578,33 @@ int main(int argc, char **argv)
 	printf("\n");
     }
 
+    /* Measure the latency distribution of each request type */
+    if (latency && (errors == 0))
+	eval_mm_latency(tracedir, tracefiles, num_tracefiles);
+
+    /* Count cycles, cache misses etc. while replaying each trace */
+    if (counters && (errors == 0))
+	eval_mm_counters(tracedir, tracefiles, num_tracefiles);
+
+    /* Measure how the package scales with the number of threads */
+    if ((nthreads > 0) && !team.thread_safe)
+	printf("\n%s is not thread-safe, skipping -j\n", team.teamname);
+    else if ((nthreads > 0) && !stream && (errors == 0))
+	eval_mm_threads(tracedir, tracefiles, num_tracefiles, nthreads);
+
     /* 
      * Accumulate the aggregate statistics for the student's mm package 
      */
     secs = 0;
     ops = 0;
     util = 0;
-    numcorrect = 0;
+    *numcorrect = 0;
     for (i=0; i < num_tracefiles; i++) {
 	secs += mm_stats[i].secs;
 	ops += mm_stats[i].ops;
 	util += mm_stats[i].util;
 	if (mm_stats[i].valid)
-	    numcorrect++;
+	    (*numcorrect)++;
     }
     avg_mm_util = util/num_tracefiles;
 
@@ -357,32 +635,351 @@ int main(int argc, char **argv)
 	printf("Terminated with %d errors\n", errors);
     }
 
-    if (autograder) {
-	printf("correct:%d\n", numcorrect);
-	printf("perfidx:%.0f\n", perfindex);
+    return perfindex;
+}
+
+/*
+ * eval_mm_trace - Evaluates the correctness, utilization and speed of 
+ *    the mm package on one trace
+ */
+static void eval_mm_trace(char *tracedir, char *filename, int tracenum, 
+			  stats_t *stats)
+{
+    trace_t *trace;            /* stores a single trace file in memory */
+    range_t *ranges = NULL;    /* keeps track of block extents for one trace */
+    speed_t speed_params;      /* input parameters to eval_mm_speed */
+
+    if (stream) {
+	/* Or with a single pass that holds only the live blocks */
+	eval_mm_stream(tracedir, filename, tracenum, stats);
+	return;
+    }
+    trace = read_trace(tracedir, filename);
+    stats->ops = trace->num_ops;
+    if (verbose > 1)
+	printf("Checking mm_malloc for correctness, ");
+    stats->valid = eval_mm_valid(trace, tracenum, &ranges);
+    if (stats->valid) {
+	if (verbose > 1)
+	    printf("efficiency, ");
+	stats->util = eval_mm_util(trace, tracenum, &ranges);
+	stats->peak = mem_heappeak();
+	stats->heap = mem_heapsize();
+	speed_params.trace = trace;
+	speed_params.ranges = ranges;
+	if (verbose > 1)
+	    printf("and performance.\n");
+	stats->secs = fsecs_full(eval_mm_speed, &speed_params, &stats->timing);
     }
+    clear_ranges(&ranges);
+    free_trace(trace);
+}
 
-    exit(0);
+/*
+ * eval_mm_workers - Evaluates up to workers traces at once, each in a
+ *    forked process with its own copy of the heap, and collects their
+ *    stats over a pipe per worker. A worker that dies (say, of a 
+ *    segfault in the package) fails its trace.
+ */
+static void eval_mm_workers(char *tracedir, char **tracefiles, 
+			    int num_tracefiles, stats_t *mm_stats)
+{
+    pid_t pid, *pids;
+    int *fds, fd[2];
+    int t, next = 0, running = 0, status;
+    result_t res;
+
+    pids = (pid_t *)calloc(num_tracefiles, sizeof(pid_t));
+    fds = (int *)calloc(num_tracefiles, sizeof(int));
+    if ((pids == NULL) || (fds == NULL))
+	unix_error("calloc in eval_mm_workers failed");
+    fflush(stdout); /* or the workers would print it again */
+
+    while ((next < num_tracefiles) || (running > 0)) {
+	/* Start another worker if there is room */
+	if ((next < num_tracefiles) && (running < workers)) {
+	    if (pipe(fd) < 0)
+		unix_error("pipe in eval_mm_workers failed");
+	    if ((pid = fork()) < 0)
+		unix_error("fork in eval_mm_workers failed");
+	    if (pid == 0) {
+		close(fd[0]);
+		memset(&res, 0, sizeof(res));
+		errors = 0;
+		eval_mm_trace(tracedir, tracefiles[next], next, &res.stats);
+		res.errors = errors;
+		fflush(stdout);
+		/* Smaller than PIPE_BUF, so it fits in the empty pipe */
+		if (write(fd[1], &res, sizeof(res)) != sizeof(res))
+		    _exit(1);
+		_exit(0);
+	    }
+	    close(fd[1]);
+	    pids[next] = pid;
+	    fds[next] = fd[0];
+	    next++;
+	    running++;
+	    continue;
+	}
+
+	/* Otherwise collect the next worker to finish */
+	if ((pid = waitpid(-1, &status, 0)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    unix_error("waitpid in eval_mm_workers failed");
+	}
+	for (t = 0; (t < next) && (pids[t] != pid); t++)
+	    ;
+	if (t == next)
+	    continue;
+	running--;
+	if (read(fds[t], &res, sizeof(res)) == sizeof(res)) {
+	    mm_stats[t] = res.stats;
+	    errors += res.errors;
+	}
+	else {
+	    mm_stats[t].valid = 0;
+	    errors++;
+	    if (WIFSIGNALED(status))
+		printf("ERROR [trace %d]: worker killed by signal %d\n", 
+		       t, WTERMSIG(status));
+	    else
+		printf("ERROR [trace %d]: worker exited with status %d\n", 
+		       t, WEXITSTATUS(status));
+	}
+	close(fds[t]);
+    }
+    free(pids);
+    free(fds);
+}
+
+#ifdef MM_ALL
+/*
+ * eval_mm_all - Evaluates every package in mm_packages[] (mmall.c) in
+ *    turn and compares their utilization, throughput and performance
+ *    index, with libc's throughput if libc_stats is not NULL. Deltas 
+ *    are against the first package.
+ */
+static void eval_mm_all(char *tracedir, char **tracefiles, 
+			int num_tracefiles, stats_t *libc_stats)
+{
+    int i, k, npackages, numcorrect;
+    stats_t *stats, *s;
+    double *perf, *util, *kops, ops, secs;
+    int *failed;
+    mm_package_t *p;
+
+    for (npackages = 0; mm_packages[npackages].name != NULL; npackages++)
+	;
+    stats = (stats_t *)calloc(npackages * num_tracefiles, sizeof(stats_t));
+    perf = (double *)calloc(3 * npackages, sizeof(double));
+    failed = (int *)calloc(npackages, sizeof(int));
+    if ((stats == NULL) || (perf == NULL) || (failed == NULL))
+	unix_error("calloc in eval_mm_all failed");
+    util = perf + npackages;
+    kops = util + npackages;
+
+    for (k = 0; k < npackages; k++) {
+	p = &mm_packages[k];
+	mm_select(p->name);
+	printf("\nPackage %s (%s):\n", p->name, p->team->teamname);
+	errors = 0;
+	s = &stats[k * num_tracefiles];
+	perf[k] = eval_mm_package(tracedir, tracefiles, num_tracefiles, 
+				  s, &numcorrect);
+	failed[k] = (errors > 0);
+	ops = secs = 0;
+	for (i = 0; i < num_tracefiles; i++) {
+	    util[k] += s[i].util;
+	    ops += s[i].ops;
+	    secs += s[i].secs;
+	}
+	util[k] /= num_tracefiles;
+	kops[k] = failed[k] ? 0 : (ops/1e3)/secs;
+    }
+
+    /* Utilization and throughput of each package on each trace */
+    printf("\nUtilization by trace:\n%5s", "trace");
+    for (k = 0; k < npackages; k++)
+	printf("%10s", mm_packages[k].name);
+    printf("\n");
+    for (i = 0; i < num_tracefiles; i++) {
+	printf("%2d%3s", i, "");
+	for (k = 0; k < npackages; k++) {
+	    s = &stats[k * num_tracefiles + i];
+	    if (s->valid)
+		printf("%9.0f%%", s->util*100.0);
+	    else
+		printf("%10s", "-");
+	}
+	printf("\n");
+    }
+
+    printf("\nKops by trace:\n%5s", "trace");
+    for (k = 0; k < npackages; k++)
+	printf("%10s", mm_packages[k].name);
+    if (libc_stats)
+	printf("%10s", "libc");
+    printf("\n");
+    for (i = 0; i < num_tracefiles; i++) {
+	printf("%2d%3s", i, "");
+	for (k = 0; k < npackages; k++) {
+	    s = &stats[k * num_tracefiles + i];
+	    if (s->valid)
+		printf("%10.0f", (s->ops/1e3)/s->secs);
+	    else
+		printf("%10s", "-");
+	}
+	if (libc_stats && libc_stats[i].valid)
+	    printf("%10.0f", (libc_stats[i].ops/1e3)/libc_stats[i].secs);
+	else if (libc_stats)
+	    printf("%10s", "-");
+	printf("\n");
+    }
+
+    /* Totals, and how each package differs from the first */
+    printf("\nComparison (deltas against %s):\n", mm_packages[0].name);
+    printf("%-10s%6s%8s%6s%8s%9s%7s\n", 
+	   "package", "util", "Kops", "perf", "d-util", "d-Kops", "d-perf");
+    for (k = 0; k < npackages; k++) {
+	if (failed[k]) {
+	    printf("%-10s%6s%8s%6s%8s%9s%7s\n", 
+		   mm_packages[k].name, "-", "-", "-", "-", "-", "-");
+	    continue;
+	}
+	printf("%-10s%5.0f%%%8.0f%6.0f", 
+	       mm_packages[k].name, util[k]*100.0, kops[k], perf[k]);
+	if ((k == 0) || failed[0])
+	    printf("%8s%9s%7s\n", "", "", "");
+	else
+	    printf("%+7.0f%%%+8.0f%%%+7.0f\n", 
+		   (util[k] - util[0])*100.0, 
+		   (kops[k]/kops[0] - 1)*100.0, 
+		   perf[k] - perf[0]);
+    }
+    if (libc_stats) {
+	ops = secs = 0;
+	for (i = 0; i < num_tracefiles; i++) {
+	    ops += libc_stats[i].ops;
+	    secs += libc_stats[i].secs;
+	}
+	printf("%-10s%6s%8.0f\n", "libc", "-", (ops/1e3)/secs);
+    }
+
+    free(stats);
+    free(perf);
+    free(failed);
 }
+#endif
 
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps 
+ * The following routines manipulate the range tree, which keeps 
  * track of the extent of every allocated block payload. We use the 
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks.
+ *
+ * The tree is a splay tree ordered by payload address, so checking
+ * a new block against its neighbors and removing a block take 
+ * amortized O(log n) time. Range records come from a pool of 
+ * RANGE_CHUNK-sized chunks that is only given back by clear_ranges.
  ****************************************************************/
 
+/*
+ * new_range - Take a range record from the pool
+ */
+static range_t *new_range(void)
+{
+    range_t *p;
+    range_chunk_t *chunk;
+
+    if ((p = range_free) != NULL) {
+	range_free = p->right;
+	return p;
+    }
+    if ((range_pool == NULL) || (range_pool->used == RANGE_CHUNK)) {
+	if ((chunk = (range_chunk_t *)malloc(sizeof(range_chunk_t))) == NULL)
+	    unix_error("malloc error in new_range");
+	chunk->next = range_pool;
+	chunk->used = 0;
+	range_pool = chunk;
+    }
+    return &range_pool->nodes[range_pool->used++];
+}
+
+/*
+ * free_range - Give a range record back to the pool
+ */
+static void free_range(range_t *p)
+{
+    p->right = range_free;
+    range_free = p;
+}
+
+/*
+ * splay_range - Top-down splay of the tree t on address lo. The record
+ *     starting at lo, or the last one visited on the way to it, 
+ *     becomes the new root.
+ */
+static range_t *splay_range(range_t *t, char *lo)
+{
+    range_t n, *l, *r, *y;
+
+    if (t == NULL)
+	return NULL;
+    n.left = n.right = NULL;
+    l = r = &n;
+    for (;;) {
+	if (lo < t->lo) {
+	    if (t->left == NULL)
+		break;
+	    if (lo < t->left->lo) {   /* rotate right */
+		y = t->left;
+		t->left = y->right;
+		y->right = t;
+		t = y;
+		if (t->left == NULL)
+		    break;
+	    }
+	    r->left = t;              /* link right */
+	    r = t;
+	    t = t->left;
+	}
+	else if (lo > t->lo) {
+	    if (t->right == NULL)
+		break;
+	    if (lo > t->right->lo) {  /* rotate left */
+		y = t->right;
+		t->right = y->left;
+		y->left = t;
+		t = y;
+		if (t->right == NULL)
+		    break;
+	    }
+	    l->right = t;             /* link left */
+	    l = t;
+	    t = t->right;
+	}
+	else
+	    break;
+    }
+    l->right = t->left;               /* assemble */
+    r->left = t->right;
+    t->left = n.right;
+    t->right = n.left;
+    return t;
+}
+
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of 
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list. 
+ *     we create a range struct for this block and add it to the range tree. 
  */
 static int add_range(range_t **ranges, char *lo, int size, 
 		     int tracenum, int opnum)
 {
     char *hi = lo + size - 1;
-    range_t *p;
+    range_t *p, *pred, *succ;
     char msg[MAXLINE];
 
     assert(size > 0);
@@ -395,35 +992,65 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap or of a region
+       the package mapped with mem_map */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
+	 (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+	!mem_mapped(lo, hi)) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
         return 0;
     }
 
-    /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
-	    sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-		    lo, hi, p->lo, p->hi);
-	    malloc_error(tracenum, opnum, msg);
-	    return 0;
-        }
+    /* 
+     * The payload must not overlap any other payloads. Only the 
+     * payloads right before and after lo can, and both lie on the 
+     * search path that the splay below walks again.
+     */
+    pred = succ = NULL;
+    for (p = *ranges;  p != NULL; ) {
+	if (lo < p->lo) {
+	    succ = p;
+	    p = p->left;
+	}
+	else {
+	    pred = p;
+	    p = p->right;
+	}
+    }
+    p = NULL;
+    if ((pred != NULL) && (pred->hi >= lo))
+	p = pred;
+    else if ((succ != NULL) && (succ->lo <= hi))
+	p = succ;
+    if (p != NULL) {
+	sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+		lo, hi, p->lo, p->hi);
+	malloc_error(tracenum, opnum, msg);
+	return 0;
     }
 
     /* 
      * Everything looks OK, so remember the extent of this block 
-     * by creating a range struct and adding it the range list.
+     * by creating a range struct and adding it the range tree.
      */
-    if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
-	unix_error("malloc error in add_range");
-    p->next = *ranges;
+    p = new_range();
     p->lo = lo;
     p->hi = hi;
+    p->left = p->right = NULL;
+    if ((*ranges = splay_range(*ranges, lo)) != NULL) {
+	if (lo < (*ranges)->lo) {
+	    p->left = (*ranges)->left;
+	    p->right = *ranges;
+	    (*ranges)->left = NULL;
+	}
+	else {
+	    p->right = (*ranges)->right;
+	    p->left = *ranges;
+	    (*ranges)->right = NULL;
+	}
+    }
     *ranges = p;
     return 1;
 }
@@ -434,18 +1061,21 @@ static int add_range(range_t **ranges, char *lo, int size,
 static void remove_range(range_t **ranges, char *lo)
 {
     range_t *p;
-    range_t **prevpp = ranges;
-    int size;
 
-    for (p = *ranges;  p != NULL; p = p->next) {
-        if (p->lo == lo) {
-	    *prevpp = p->next;
-            size = p->hi - p->lo + 1;
-            free(p);
-            break;
-        }
-        prevpp = &(p->next);
+    if ((p = splay_range(*ranges, lo)) == NULL)
+	return;
+    if (p->lo != lo) {
+	*ranges = p;
+	return;
     }
+    if (p->left == NULL)
+	*ranges = p->right;
+    else {
+	/* lo is larger than everything on the left, so its max comes up */
+	*ranges = splay_range(p->left, lo);
+	(*ranges)->right = p->right;
+    }
+    free_range(p);
 }
 
 /*
@@ -453,13 +1083,13 @@ static void remove_range(range_t **ranges, char *lo)
  */
 static void clear_ranges(range_t **ranges)
 {
-    range_t *p;
-    range_t *pnext;
+    range_chunk_t *chunk;
 
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
+    while ((chunk = range_pool) != NULL) {
+	range_pool = chunk->next;
+	free(chunk);
     }
+    range_free = NULL;
     *ranges = NULL;
 }
 
@@ -488,9 +1118,13 @@ static trace_t *read_trace(char *tracedir, char *filename)
     if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
 	unix_error("malloc 1 failed in read_trance");
 	
-    /* Read the trace file header */
+    /* Binary tracefiles are mapped and decoded in one pass */
     strcpy(path, tracedir);
     strcat(path, filename);
+    if (read_trace_bin(trace, path))
+	return trace;
+
+    /* Read the trace file header */
     if ((tracefile = fopen(path, "r")) == NULL) {
 	sprintf(msg, "Could not open %s in read_trace", path);
 	unix_error(msg);
@@ -499,21 +1133,7 @@ static trace_t *read_trace(char *tracedir, char *filename)
     fscanf(tracefile, "%d", &(trace->num_ids));     
     fscanf(tracefile, "%d", &(trace->num_ops));     
     fscanf(tracefile, "%d", &(trace->weight));        /* not used */
-    
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops = 
-	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-	unix_error("malloc 2 failed in read_trace");
-
-    /* We'll keep an array of pointers to the allocated blocks here... */
-    if ((trace->blocks = 
-	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
-	unix_error("malloc 3 failed in read_trace");
-
-    /* ... along with the corresponding byte sizes of each block */
-    if ((trace->block_sizes = 
-	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-	unix_error("malloc 4 failed in read_trace");
+    alloc_trace(trace);
     
     /* read every request line in the trace file */
     index = 0;
@@ -554,6 +1174,95 @@ static trace_t *read_trace(char *tracedir, char *filename)
     return trace;
 }
 
+/*
+ * read_trace_bin - If path is a binary tracefile (see trace.h), map it 
+ *     and decode all of its records into trace. Returns 0 if the file 
+ *     is not a binary tracefile, so the caller can read it as text.
+ */
+static int read_trace_bin(trace_t *trace, char *path)
+{
+    int fd;
+    struct stat st;
+    void *map;
+    tracehdr_t *hdr;
+    const unsigned char *p, *end;
+    uint32_t v, size;
+    unsigned op_index;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+	sprintf(msg, "Could not open %s in read_trace", path);
+	unix_error(msg);
+    }
+    if (fstat(fd, &st) < 0)
+	unix_error("fstat failed in read_trace_bin");
+    if (st.st_size < sizeof(tracehdr_t)) {
+	close(fd);
+	return 0;
+    }
+    if ((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) 
+	== MAP_FAILED)
+	unix_error("mmap failed in read_trace_bin");
+    close(fd);
+
+    hdr = (tracehdr_t *)map;
+    if (hdr->magic != TRACE_MAGIC) {
+	munmap(map, st.st_size);
+	return 0;
+    }
+    if ((hdr->version != TRACE_VERSION) || 
+	(hdr->data_bytes > st.st_size - sizeof(tracehdr_t))) {
+	printf("Bad binary tracefile header in %s\n", path);
+	exit(1);
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    trace->sugg_heapsize = hdr->sugg_heapsize; /* not used */
+    trace->num_ids = hdr->num_ids;
+    trace->num_ops = hdr->num_ops;
+    trace->weight = hdr->weight;               /* not used */
+    alloc_trace(trace);
+
+    /* Decode every record straight out of the mapping */
+    p = (const unsigned char *)(hdr + 1);
+    end = p + hdr->data_bytes;
+    for (op_index = 0; op_index < trace->num_ops; op_index++) {
+	size = 0;
+	if (((p = get_varint(p, end, &v)) == NULL) || 
+	    (((v & 3) != TREC_FREE) && ((p = get_varint(p, end, &size)) == NULL)) ||
+	    ((v & 3) > TREC_REALLOC) || ((v >> 2) >= trace->num_ids)) {
+	    printf("Bad record %u in binary tracefile %s\n", op_index, path);
+	    exit(1);
+	}
+	trace->ops[op_index].type = ((v & 3) == TREC_ALLOC) ? ALLOC :
+	    ((v & 3) == TREC_FREE) ? FREE : REALLOC;
+	trace->ops[op_index].index = v >> 2;
+	trace->ops[op_index].size = size;
+    }
+    munmap(map, st.st_size);
+    return 1;
+}
+
+/*
+ * alloc_trace - Allocate the arrays of a trace whose header has been read
+ */
+static void alloc_trace(trace_t *trace)
+{
+    /* We'll store each request line in the trace in this array */
+    if ((trace->ops = 
+	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+	unix_error("malloc 2 failed in read_trace");
+
+    /* We'll keep an array of pointers to the allocated blocks here... */
+    if ((trace->blocks = 
+	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+	unix_error("malloc 3 failed in read_trace");
+
+    /* ... along with the corresponding byte sizes of each block */
+    if ((trace->block_sizes = 
+	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+	unix_error("malloc 4 failed in read_trace");
+}
+
 /*
  * free_trace - Free the trace record and the three arrays it points
  *              to, all of which were allocated in read_trace().
@@ -653,7 +1362,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -689,10 +1398,9 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for 
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
+ *   high water mark of the heap in bytes while running the student's
+ *   malloc package on the trace. mem_sbrk() lets the students decrement
+ *   the brk pointer, so the final brk may be lower than heapsize.
  *   
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
@@ -774,7 +1482,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         }
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    return ((double)max_total_size / (double)mem_heappeak());
 }
 
 
@@ -825,6 +1533,749 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_threads - Replays every trace on 1 and then on nthreads
+ *    threads at once, each thread running its own copy of the trace
+ *    against the shared mm package, and prints the aggregate and
+ *    per-thread throughput with the scaling efficiency against 1 thread.
+ */
+static void eval_mm_threads(char *tracedir, char **tracefiles, 
+			    int num_tracefiles, int nthreads)
+{
+    int i, t;
+    trace_t *trace;
+    double secs1, secsn, kops1, kopsn;
+    double thread_secs[MAXTHREADS];
+
+    printf("\nResults for mm malloc on %d thread%s (best of %d runs):\n", 
+	   nthreads, (nthreads > 1) ? "s" : "", JREPS);
+    printf("%5s%10s%10s%9s%7s  %s\n", 
+	   "trace", " 1T Kops", "agg Kops", "speedup", "eff", "per-thread Kops");
+    for (i = 0; i < num_tracefiles; i++) {
+	trace = read_trace(tracedir, tracefiles[i]);
+	secs1 = eval_mm_parallel(trace, 1, NULL);
+	secsn = eval_mm_parallel(trace, nthreads, thread_secs);
+
+	/* Every thread replays the whole trace, so n times the ops */
+	kops1 = (double)trace->num_ops / secs1 / 1e3;
+	kopsn = (double)trace->num_ops * nthreads / secsn / 1e3;
+	printf("%2d%3s%10.0f%10.0f%8.2fx%6.0f%% ", 
+	       i, "", kops1, kopsn, kopsn / kops1, 
+	       100.0 * kopsn / (nthreads * kops1));
+	for (t = 0; t < nthreads; t++)
+	    printf(" %.0f", (double)trace->num_ops / thread_secs[t] / 1e3);
+	printf("\n");
+	free_trace(trace);
+    }
+}
+
+/*
+ * now_secs - Monotonic wall clock in seconds
+ */
+static double now_secs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * eval_mm_parallel - Starts nthreads replay threads together on a
+ *    fresh heap and returns the wall time (first start to last end)
+ *    of the fastest of JREPS runs. If thread_secs is not NULL, it
+ *    gets each thread's own time in that run.
+ */
+static double eval_mm_parallel(trace_t *trace, int nthreads, double *thread_secs)
+{
+    int i, rep;
+    double secs, first, last, best = DBL_MAX;
+    pthread_t tids[MAXTHREADS];
+    replay_t args[MAXTHREADS];
+    pthread_barrier_t barrier;
+
+    for (rep = 0; rep < JREPS; rep++) {
+	/* Reset the heap and initialize the mm package */
+	mem_reset_brk();
+	if (mm_init() < 0) 
+	    app_error("mm_init failed in eval_mm_parallel");
+
+	/* The main thread is the last one to reach the barrier */
+	pthread_barrier_init(&barrier, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; i++) {
+	    args[i].trace = trace;
+	    args[i].start = &barrier;
+	    if ((args[i].blocks = calloc(trace->num_ids, sizeof(char *))) == NULL)
+		unix_error("calloc failed in eval_mm_parallel");
+	    if (pthread_create(&tids[i], NULL, replay_thread, &args[i]) != 0)
+		unix_error("pthread_create failed in eval_mm_parallel");
+	}
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < nthreads; i++)
+	    pthread_join(tids[i], NULL);
+	pthread_barrier_destroy(&barrier);
+
+	first = DBL_MAX;
+	last = 0;
+	for (i = 0; i < nthreads; i++) {
+	    if (args[i].start_secs < first)
+		first = args[i].start_secs;
+	    if (args[i].end_secs > last)
+		last = args[i].end_secs;
+	}
+	secs = last - first;
+	if (secs < best) {
+	    best = secs;
+	    for (i = 0; thread_secs && i < nthreads; i++)
+		thread_secs[i] = args[i].end_secs - args[i].start_secs;
+	}
+	for (i = 0; i < nthreads; i++)
+	    free(args[i].blocks);
+    }
+    return best;
+}
+
+/*
+ * replay_thread - Body of a replay thread. Same as eval_mm_speed, but
+ *    keeps its blocks in its own array so the threads don't share ids.
+ */
+static void *replay_thread(void *ptr)
+{
+    int i, index;
+    char *p;
+    replay_t *arg = (replay_t *)ptr;
+    trace_t *trace = arg->trace;
+
+    pthread_barrier_wait(arg->start);
+    arg->start_secs = now_secs();
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+            if ((p = mm_malloc(trace->ops[i].size)) == NULL)
+		app_error("mm_malloc error in replay_thread");
+            arg->blocks[index] = p;
+            break;
+
+	case REALLOC: /* mm_realloc */
+            if ((p = mm_realloc(arg->blocks[index], trace->ops[i].size)) == NULL)
+		app_error("mm_realloc error in replay_thread");
+            arg->blocks[index] = p;
+            break;
+
+        case FREE: /* mm_free */
+            mm_free(arg->blocks[index]);
+            break;
+
+	default:
+	    app_error("Nonexistent request type in replay_thread");
+        }
+    }
+    arg->end_secs = now_secs();
+    return NULL;
+}
+
+/*
+ * eval_mm_latency - Times every request of every trace with read_counter
+ *    over LAT_RUNS replays, after one untimed warm-up, and prints the 
+ *    median, tail percentiles and maximum of each request type. The 
+ *    cost of reading the counter is taken off each sample.
+ */
+static void eval_mm_latency(char *tracedir, char **tracefiles, 
+			    int num_tracefiles)
+{
+    static const char *names[] = {"malloc", "free", "realloc"};
+    int i, t, run, op, index;
+    trace_t *trace;
+    hist_t *hists;
+    char *p;
+    unsigned long long start, end, ovhd, lat;
+
+    if ((hists = (hist_t *)malloc(3 * sizeof(hist_t))) == NULL)
+	unix_error("malloc failed in eval_mm_latency");
+
+    /* Counter overhead: the fastest of many back-to-back reads */
+    ovhd = ~0ULL;
+    for (i = 0; i < 1000; i++) {
+	start = read_counter();
+	end = read_counter();
+	if (end - start < ovhd)
+	    ovhd = end - start;
+    }
+
+    printf("\nLatency of mm requests in %s (%d runs, less %llu counter overhead):\n", 
+	   LAT_UNIT, LAT_RUNS, ovhd);
+    printf("%5s %-8s%10s%8s%8s%8s%8s%10s\n", 
+	   "trace", "request", "count", "min", "p50", "p99", "p999", "max");
+    for (t = 0; t < num_tracefiles; t++) {
+	trace = read_trace(tracedir, tracefiles[t]);
+	memset(hists, 0, 3 * sizeof(hist_t));
+	for (run = 0; run <= LAT_RUNS; run++) {
+	    /* Reset the heap and initialize the mm package */
+	    mem_reset_brk();
+	    if (mm_init() < 0) 
+		app_error("mm_init failed in eval_mm_latency");
+
+	    for (i = 0; i < trace->num_ops; i++) {
+		index = trace->ops[i].index;
+		switch (op = trace->ops[i].type) {
+
+		case ALLOC: /* mm_malloc */
+		    start = read_counter();
+		    p = mm_malloc(trace->ops[i].size);
+		    end = read_counter();
+		    if (p == NULL)
+			app_error("mm_malloc error in eval_mm_latency");
+		    trace->blocks[index] = p;
+		    break;
+
+		case REALLOC: /* mm_realloc */
+		    start = read_counter();
+		    p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+		    end = read_counter();
+		    if (p == NULL)
+			app_error("mm_realloc error in eval_mm_latency");
+		    trace->blocks[index] = p;
+		    break;
+
+		case FREE: /* mm_free */
+		    start = read_counter();
+		    mm_free(trace->blocks[index]);
+		    end = read_counter();
+		    break;
+
+		default:
+		    app_error("Nonexistent request type in eval_mm_latency");
+		}
+
+		/* The first run only warms up the caches */
+		if (run > 0) {
+		    lat = end - start;
+		    hist_add(&hists[op], (lat > ovhd) ? lat - ovhd : 0);
+		}
+	    }
+	}
+
+	for (op = 0; op < 3; op++) {
+	    if (hists[op].count == 0)
+		continue;
+	    printf("%2d%3s %-8s%10llu%8llu%8llu%8llu%8llu%10llu\n", 
+		   t, "", names[op], hists[op].count / LAT_RUNS,
+		   hist_percentile(&hists[op], 0.0),
+		   hist_percentile(&hists[op], 50.0),
+		   hist_percentile(&hists[op], 99.0),
+		   hist_percentile(&hists[op], 99.9),
+		   hists[op].max);
+	}
+	free_trace(trace);
+    }
+    free(hists);
+}
+
+/*
+ * hist_add - Record v in histogram h
+ */
+static void hist_add(hist_t *h, unsigned long long v)
+{
+    int msb, shift, idx;
+
+    if (v < HIST_SUBS)
+	idx = (int)v;
+    else {
+	msb = 63 - __builtin_clzll(v);
+	shift = msb - HIST_SUB_BITS;
+	idx = ((shift + 1) << HIST_SUB_BITS) | (int)((v >> shift) & (HIST_SUBS - 1));
+    }
+    h->buckets[idx]++;
+    h->count++;
+    if (v > h->max)
+	h->max = v;
+}
+
+/*
+ * hist_percentile - Smallest value that at least pct percent of the 
+ *    samples in h do not exceed, rounded up to the top of its bucket
+ */
+static unsigned long long hist_percentile(hist_t *h, double pct)
+{
+    unsigned long long want, seen = 0, top;
+    int idx, shift;
+
+    want = (unsigned long long)(pct / 100.0 * h->count + 0.5);
+    if (want == 0)
+	want = 1;
+    for (idx = 0; idx < HIST_BUCKETS; idx++) {
+	if ((seen += h->buckets[idx]) < want)
+	    continue;
+	if (idx < HIST_SUBS)
+	    return idx;
+	shift = (idx >> HIST_SUB_BITS) - 1;
+	top = ((unsigned long long)(HIST_SUBS + (idx & (HIST_SUBS - 1)) + 1) << shift) - 1;
+	return (top < h->max) ? top : h->max;
+    }
+    return h->max;
+}
+
+/*
+ * eval_mm_counters - Counts hardware events in user mode while 
+ *    eval_mm_speed replays each trace PERF_RUNS times, after one 
+ *    uncounted warm-up, and prints them per request. Each event has a
+ *    counter of its own; if the PMU has fewer counters than events, the
+ *    kernel time-shares them and the counts are scaled up to the whole
+ *    replay. Events the machine does not have are shown as "-".
+ */
+static void eval_mm_counters(char *tracedir, char **tracefiles, 
+			     int num_tracefiles)
+{
+#ifdef __linux__
+#define CACHE_MISS(cache, op) \
+    ((cache) | ((op) << 8) | ((unsigned long long)PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+    static counter_t counter_events[NCOUNTERS] = {
+	{"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"instrs", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"L1dmiss", PERF_TYPE_HW_CACHE, 
+	 CACHE_MISS(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ)},
+	{"LLCmiss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{"brmiss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{"dTLBmiss", PERF_TYPE_HW_CACHE, 
+	 CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ)},
+    };
+    int fds[NCOUNTERS];
+    double count[NCOUNTERS];
+    int i, t, run, nopen = 0;
+    trace_t *trace;
+    speed_t params;
+
+    for (i = 0; i < NCOUNTERS; i++)
+	if ((fds[i] = counter_open(&counter_events[i])) >= 0)
+	    nopen++;
+    if (nopen == 0) {
+	printf("\nNo hardware counters (perf_event_open failed; see "
+	       "/proc/sys/kernel/perf_event_paranoid)\n");
+	return;
+    }
+
+    printf("\nHardware events per request (user mode, %d runs):\n", PERF_RUNS);
+    printf("%5s", "trace");
+    for (i = 0; i < NCOUNTERS; i++)
+	printf("%9s", counter_events[i].name);
+    printf("%6s\n", "IPC");
+    for (t = 0; t < num_tracefiles; t++) {
+	trace = read_trace(tracedir, tracefiles[t]);
+	params.trace = trace;
+	eval_mm_speed(&params);  /* warm up the caches and the heap */
+	for (i = 0; i < NCOUNTERS; i++)
+	    if (fds[i] >= 0) {
+		ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	    }
+	for (run = 0; run < PERF_RUNS; run++)
+	    eval_mm_speed(&params);
+	for (i = 0; i < NCOUNTERS; i++)
+	    if (fds[i] >= 0) {
+		ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		count[i] = counter_read(fds[i]) / PERF_RUNS / trace->num_ops;
+	    }
+
+	printf("%2d%3s", t, "");
+	for (i = 0; i < NCOUNTERS; i++)
+	    if (fds[i] >= 0)
+		printf("%9.2f", count[i]);
+	    else
+		printf("%9s", "-");
+	if ((fds[0] >= 0) && (fds[1] >= 0) && (count[0] > 0))
+	    printf("%6.2f\n", count[1] / count[0]);
+	else
+	    printf("%6s\n", "-");
+	free_trace(trace);
+    }
+
+    for (i = 0; i < NCOUNTERS; i++)
+	if (fds[i] >= 0)
+	    close(fds[i]);
+#else
+    printf("\nHardware counters are only supported on Linux\n");
+#endif
+}
+
+#ifdef __linux__
+/*
+ * counter_open - Open a disabled counter of event ev for this thread, 
+ *    in user mode only, or return -1 if the machine cannot count it
+ */
+static int counter_open(counter_t *ev)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = ev->type;
+    attr.config = ev->config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * counter_read - Count of a counter, scaled up for the time it was
+ *    not on the PMU
+ */
+static double counter_read(int fd)
+{
+    unsigned long long v[3]; /* count, time enabled, time running */
+
+    if ((read(fd, v, sizeof(v)) != sizeof(v)) || (v[2] == 0))
+	return 0;
+    return (double)v[0] * v[1] / v[2];
+}
+#endif
+
+/*
+ * eval_mm_stream - Replays a trace through mm in a single pass while a
+ *    reader thread fills the next STREAM_CHUNK requests into the other
+ *    buffer. Ids map to live blocks in a hash table, so memory use 
+ *    follows the live blocks instead of the length of the trace. 
+ *    Payloads are checked for alignment but not for overlaps, and 
+ *    secs leaves out the time spent waiting for the reader.
+ */
+static void eval_mm_stream(char *tracedir, char *filename, int tracenum, 
+			   stats_t *stats)
+{
+    stream_t *s;
+    pthread_t tid;
+    idmap_t ids;
+    idslot_t *slot;
+    traceop_t *op;
+    char *p, msg[MAXLINE];
+    int b, i, last, valid = 1;
+    size_t live = 0, max_live = 0;
+    double start, wait, waited = 0;
+    unsigned op_index = 0, max_ids = 0;
+
+    if (verbose > 1)
+	printf("Streaming tracefile: %s\n", filename);
+
+    /* Reset the heap and initialize the mm package */
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	malloc_error(tracenum, 0, "mm_init failed.");
+	return;
+    }
+
+    if ((s = (stream_t *)calloc(1, sizeof(stream_t))) == NULL)
+	unix_error("calloc failed in eval_mm_stream");
+    if ((s->path = malloc(strlen(tracedir) + strlen(filename) + 1)) == NULL)
+	unix_error("malloc failed in eval_mm_stream");
+    strcpy(s->path, tracedir);
+    strcat(s->path, filename);
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    idmap_init(&ids, IDMAP_BITS);
+
+    if (pthread_create(&tid, NULL, stream_reader, s) != 0)
+	unix_error("pthread_create failed in eval_mm_stream");
+    start = now_secs();
+    for (b = 0, last = 0; !last; b ^= 1) {
+	/* Wait for the reader to fill this buffer */
+	wait = now_secs();
+	pthread_mutex_lock(&s->lock);
+	while (!s->buf[b].full)
+	    pthread_cond_wait(&s->cond, &s->lock);
+	pthread_mutex_unlock(&s->lock);
+	waited += now_secs() - wait;
+
+	/* After an error the rest of the trace is read but not replayed */
+	for (i = 0; valid && (i < s->buf[b].count); i++, op_index++) {
+	    op = &s->buf[b].ops[i];
+	    switch (op->type) {
+
+	    case ALLOC: /* mm_malloc */
+	    case REALLOC: /* mm_realloc */
+		slot = idmap_find(&ids, op->index);
+		if (op->type == ALLOC)
+		    p = mm_malloc(op->size);
+		else
+		    p = mm_realloc(slot ? slot->ptr : NULL, op->size);
+		if (p == NULL) {
+		    malloc_error(tracenum, op_index, "mm_malloc or mm_realloc failed.");
+		    valid = 0;
+		    break;
+		}
+		if (!IS_ALIGNED(p)) {
+		    sprintf(msg, "Payload address (%p) not aligned to %d bytes", 
+			    p, ALIGNMENT);
+		    malloc_error(tracenum, op_index, msg);
+		    valid = 0;
+		    break;
+		}
+		if (slot == NULL) {
+		    slot = idmap_insert(&ids, op->index);
+		    max_ids = (ids.count > max_ids) ? ids.count : max_ids;
+		}
+		else
+		    live -= slot->size;
+		slot->ptr = p;
+		slot->size = op->size;
+		live += op->size;
+		max_live = (live > max_live) ? live : max_live;
+		break;
+
+	    case FREE: /* mm_free */
+		if ((slot = idmap_find(&ids, op->index)) == NULL)
+		    break;
+		mm_free(slot->ptr);
+		live -= slot->size;
+		idmap_remove(&ids, slot);
+		break;
+	    }
+	}
+
+	/* Hand the buffer back; a short one was the last */
+	last = (s->buf[b].count < STREAM_CHUNK);
+	pthread_mutex_lock(&s->lock);
+	s->buf[b].full = 0;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+    }
+    stats->secs = now_secs() - start - waited;
+    pthread_join(tid, NULL);
+
+    stats->ops = op_index;
+    stats->valid = valid;
+    stats->util = (double)max_live / (double)mem_heappeak();
+    stats->peak = mem_heappeak();
+    stats->heap = mem_heapsize();
+    if (verbose > 1)
+	printf("Streamed %u requests, at most %u live ids\n", 
+	       op_index, max_ids);
+
+    free(ids.slots);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s->path);
+    free(s);
+}
+
+/*
+ * stream_reader - Body of the streaming reader thread. Opens the 
+ *    tracefile and fills the two buffers in turn until a short one 
+ *    marks the end of the trace.
+ */
+static void *stream_reader(void *ptr)
+{
+    stream_t *s = (stream_t *)ptr;
+    struct stat st;
+    tracehdr_t *hdr;
+    int b, fd, n, sugg_heapsize, weight;
+
+    /* Binary tracefiles are mapped, text ones read through stdio */
+    if ((fd = open(s->path, O_RDONLY)) < 0) {
+	sprintf(msg, "Could not open %s in stream_reader", s->path);
+	unix_error(msg);
+    }
+    if (fstat(fd, &st) < 0)
+	unix_error("fstat failed in stream_reader");
+    if (st.st_size >= sizeof(tracehdr_t)) {
+	if ((s->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) 
+	    == MAP_FAILED)
+	    unix_error("mmap failed in stream_reader");
+	hdr = (tracehdr_t *)s->map;
+	if (hdr->magic != TRACE_MAGIC) {
+	    munmap(s->map, st.st_size);
+	    s->map = NULL;
+	}
+	else if ((hdr->version != TRACE_VERSION) || 
+		 (hdr->data_bytes > st.st_size - sizeof(tracehdr_t))) {
+	    printf("Bad binary tracefile header in %s\n", s->path);
+	    exit(1);
+	}
+	else {
+	    s->maplen = st.st_size;
+	    s->num_ids = hdr->num_ids;
+	    s->num_ops = hdr->num_ops;
+	    s->p = (const unsigned char *)(hdr + 1);
+	    s->end = s->p + hdr->data_bytes;
+	    madvise(s->map, s->maplen, MADV_SEQUENTIAL);
+	}
+    }
+    if (s->map == NULL) {
+	if ((s->file = fdopen(fd, "r")) == NULL)
+	    unix_error("fdopen failed in stream_reader");
+	if (fscanf(s->file, "%d %u %u %d", 
+		   &sugg_heapsize, &s->num_ids, &s->num_ops, &weight) != 4) {
+	    printf("Bad tracefile header in %s\n", s->path);
+	    exit(1);
+	}
+    }
+    else
+	close(fd);
+
+    for (b = 0; ; b ^= 1) {
+	/* Wait for the replayer to give this buffer back */
+	pthread_mutex_lock(&s->lock);
+	while (s->buf[b].full)
+	    pthread_cond_wait(&s->cond, &s->lock);
+	pthread_mutex_unlock(&s->lock);
+
+	n = stream_fill(s, s->buf[b].ops);
+
+	pthread_mutex_lock(&s->lock);
+	s->buf[b].count = n;
+	s->buf[b].full = 1;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+	if (n < STREAM_CHUNK)
+	    break;
+    }
+
+    if (s->map != NULL)
+	munmap(s->map, s->maplen);
+    else
+	fclose(s->file);
+    return NULL;
+}
+
+/*
+ * stream_fill - Read up to STREAM_CHUNK requests into ops and return
+ *    how many were read. Pages of a binary tracefile are dropped once
+ *    they are decoded, so they don't pile up in memory.
+ */
+static int stream_fill(stream_t *s, traceop_t *ops)
+{
+    int n;
+    uint32_t v, size;
+    unsigned index;
+    char type[MAXLINE];
+    size_t decoded, pagemask = sysconf(_SC_PAGESIZE) - 1;
+
+    for (n = 0; (n < STREAM_CHUNK) && (s->read_ops < s->num_ops); n++) {
+	if (s->map != NULL) {
+	    size = 0;
+	    if (((s->p = get_varint(s->p, s->end, &v)) == NULL) || 
+		(((v & 3) != TREC_FREE) && 
+		 ((s->p = get_varint(s->p, s->end, &size)) == NULL)) ||
+		((v & 3) > TREC_REALLOC) || ((v >> 2) >= s->num_ids)) {
+		printf("Bad record %u in binary tracefile %s\n", 
+		       s->read_ops, s->path);
+		exit(1);
+	    }
+	    ops[n].type = ((v & 3) == TREC_ALLOC) ? ALLOC :
+		((v & 3) == TREC_FREE) ? FREE : REALLOC;
+	    ops[n].index = v >> 2;
+	    ops[n].size = size;
+	}
+	else {
+	    size = 0;
+	    if ((fscanf(s->file, "%s", type) != 1) ||
+		((type[0] == 'f') ? (fscanf(s->file, "%u", &index) != 1) :
+		 (fscanf(s->file, "%u %u", &index, &size) != 2)) ||
+		((type[0] != 'a') && (type[0] != 'r') && (type[0] != 'f'))) {
+		printf("Bad request %u in tracefile %s\n", s->read_ops, s->path);
+		exit(1);
+	    }
+	    ops[n].type = (type[0] == 'a') ? ALLOC : 
+		(type[0] == 'f') ? FREE : REALLOC;
+	    ops[n].index = index;
+	    ops[n].size = size;
+	}
+	s->read_ops++;
+    }
+
+    /* Drop the whole pages decoded so far */
+    if (s->map != NULL) {
+	decoded = (s->p - (const unsigned char *)s->map) & ~pagemask;
+	if (decoded > s->dropped) {
+	    madvise((char *)s->map + s->dropped, decoded - s->dropped, 
+		    MADV_DONTNEED);
+	    s->dropped = decoded;
+	}
+    }
+    return n;
+}
+
+/*
+ * idmap_init - Make an empty id table with 1 << bits slots
+ */
+static void idmap_init(idmap_t *m, int bits)
+{
+    int i;
+
+    if ((m->slots = (idslot_t *)malloc(sizeof(idslot_t) << bits)) == NULL)
+	unix_error("malloc failed in idmap_init");
+    for (i = 0; i < (1 << bits); i++)
+	m->slots[i].id = -1;
+    m->bits = bits;
+    m->count = 0;
+}
+
+/* Home slot of id: Fibonacci hashing keeps the top bits */
+#define IDMAP_HOME(m, id) (((uint32_t)(id) * 2654435761u) >> (32 - (m)->bits))
+
+/*
+ * idmap_find - Return the slot of id, or NULL if it is not live
+ */
+static idslot_t *idmap_find(idmap_t *m, int id)
+{
+    unsigned mask = (1u << m->bits) - 1;
+    unsigned i;
+
+    for (i = IDMAP_HOME(m, id); m->slots[i].id != -1; i = (i + 1) & mask)
+	if (m->slots[i].id == id)
+	    return &m->slots[i];
+    return NULL;
+}
+
+/*
+ * idmap_insert - Return a new slot for id, which must not be live.
+ *    The table doubles once it is 3/4 full.
+ */
+static idslot_t *idmap_insert(idmap_t *m, int id)
+{
+    idmap_t old;
+    unsigned mask, i;
+
+    if (4 * (m->count + 1) > 3u << m->bits) {
+	old = *m;
+	idmap_init(m, old.bits + 1);
+	for (i = 0; i < (1u << old.bits); i++)
+	    if (old.slots[i].id != -1)
+		*idmap_insert(m, old.slots[i].id) = old.slots[i];
+	free(old.slots);
+    }
+
+    mask = (1u << m->bits) - 1;
+    for (i = IDMAP_HOME(m, id); m->slots[i].id != -1; i = (i + 1) & mask)
+	;
+    m->slots[i].id = id;
+    m->count++;
+    return &m->slots[i];
+}
+
+/*
+ * idmap_remove - Empty a slot, shifting back the slots after it that 
+ *    would otherwise no longer be found (no tombstones needed).
+ */
+static void idmap_remove(idmap_t *m, idslot_t *slot)
+{
+    unsigned mask = (1u << m->bits) - 1;
+    unsigned i = slot - m->slots;
+    unsigned j, home;
+
+    for (j = (i + 1) & mask; m->slots[j].id != -1; j = (j + 1) & mask) {
+	/* The slot at j may move to i unless its home lies in (i, j] */
+	home = IDMAP_HOME(m, m->slots[j].id);
+	if (((j - home) & mask) >= ((j - i) & mask)) {
+	    m->slots[i] = m->slots[j];
+	    i = j;
+	}
+    }
+    m->slots[i].id = -1;
+    m->count--;
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -921,34 +2372,54 @@ static void eval_libc_speed(void *ptr)
 static void printresults(int n, stats_t *stats) 
 {
     int i;
+    int timed = 0;
     double secs = 0;
     double ops = 0;
     double util = 0;
 
+    /* The spread of the timed runs is shown if the timer measured it */
+    for (i=0; i < n; i++)
+	if (stats[i].valid && (stats[i].timing.runs > 0))
+	    timed = 1;
+
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%8s%10s%6s%8s%8s", 
+	   "trace", " valid", "util", "ops", "secs", "Kops", "peakKB", "endKB");
+    if (timed)
+	printf("%10s%7s%5s", "meansecs", "sd", "runs");
+    printf("\n");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f%8lu%8lu", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
-		   (stats[i].ops/1e3)/stats[i].secs);
+		   (stats[i].ops/1e3)/stats[i].secs,
+		   (unsigned long)(stats[i].peak >> 10),
+		   (unsigned long)(stats[i].heap >> 10));
+	    if (timed && (stats[i].timing.runs > 0))
+		printf("%10.6f%6.1f%%%5d", 
+		       stats[i].timing.mean,
+		       100.0*stats[i].timing.stddev/stats[i].timing.mean,
+		       stats[i].timing.runs);
+	    printf("\n");
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
 	}
 	else {
-	    printf("%2d%10s%6s%8s%10s%6s\n", 
+	    printf("%2d%10s%6s%8s%10s%6s%8s%8s%s\n", 
 		   i,
 		   "no",
 		   "-",
 		   "-",
 		   "-",
-		   "-");
+		   "-",
+		   "-",
+		   "-",
+		   timed ? "         -      -    -" : "");
 	}
     }
 
@@ -1004,14 +2475,27 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValeps] [-f <file>] [-t <dir>] [-m <MB>] [-j <n>]\n");
+    fprintf(stderr, "               [-w <n>] [-b <package>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-b <name>  Run mm package <name>, or compare all of them\n");
+    fprintf(stderr, "\t           with \"all\" (the default; mdriver-all only).\n");
+    fprintf(stderr, "\t-e         Count hardware events (cycles, cache misses, ...)\n");
+    fprintf(stderr, "\t           per request with perf_event_open.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-j <n>     Also replay each trace on <n> threads at once\n");
+    fprintf(stderr, "\t           (needs a thread-safe package, e.g. mdriver-arena).\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-m <MB>    Limit the heap to <MB> megabytes.\n");
+    fprintf(stderr, "\t-p         Print latency percentiles of each request type.\n");
+    fprintf(stderr, "\t-s         Stream each trace through mm once, keeping\n");
+    fprintf(stderr, "\t           only the live blocks in memory.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
+    fprintf(stderr, "\t-w <n>     Evaluate up to <n> traces at once, each in a\n");
+    fprintf(stderr, "\t           process of its own (one per core is a good <n>).\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
 }
@@ -2,7 +2,12 @@
  * memlib.c - a module that simulates the memory system.  Needed because it 
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
+ *
+ * Besides the sbrk heap, memlib hands out regions mapped on their own
+ * (mem_map) for large blocks. They live outside the heap's address
+ * range but count towards its size, its peak and its limit.
  */
+#define _GNU_SOURCE /* mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,24 +19,64 @@
 #include "memlib.h"
 #include "config.h"
 
+/* Head of a region handed out by mem_map, on the list of live regions */
+typedef struct map_t {
+    struct map_t *prev, *next;
+    size_t len;               /* bytes mapped, this header included */
+} map_t;
+
+/* Header size, rounded so the region's payload is ALIGNMENT aligned */
+#define MAP_HDRSIZE ((sizeof(map_t) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1))
+
 /* private variables */
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static size_t mem_peak;      /* largest heap size since the last reset */
+static map_t *mem_maps;      /* regions from mem_map, newest first */
+static size_t mem_map_bytes; /* bytes in those regions */
+#if USE_MMAP_HEAP
+static char *mem_commit_brk; /* end of the committed (read/write) pages */
+#endif
+static size_t mem_max_heap = MAX_HEAP;  /* heap size limit set by mem_setmax */
+
+/*
+ * mem_setmax - set the maximum heap size in bytes. Must be called
+ *    before mem_init.
+ */
+int mem_setmax(size_t size)
+{
+    if ((size == 0) || (size > MAX_HEAP_LIMIT))
+	return -1;
+    mem_max_heap = size;
+    return 0;
+}
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
+#if USE_MMAP_HEAP
+    /* reserve address space only; pages are committed in mem_sbrk */
+    mem_start_brk = mmap(NULL, mem_max_heap, PROT_NONE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_start_brk == MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
+	exit(1);
+    }
+    mem_commit_brk = mem_start_brk;
+#else
     /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
+    if ((mem_start_brk = (char *)malloc(mem_max_heap)) == NULL) {
 	fprintf(stderr, "mem_init_vm: malloc error\n");
 	exit(1);
     }
+#endif
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
+    mem_max_addr = mem_start_brk + mem_max_heap;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_peak = 0;
 }
 
 /* 
@@ -39,35 +84,197 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
+    mem_reset_brk();  /* unmaps the regions from mem_map */
+#if USE_MMAP_HEAP
+    munmap(mem_start_brk, mem_max_heap);
+#else
     free(mem_start_brk);
+#endif
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer and unmap every
+ *    region from mem_map to make an empty heap
  */
 void mem_reset_brk()
 {
+    map_t *m, *next;
+
+    for (m = mem_maps; m != NULL; m = next) {
+	next = m->next;
+	munmap(m, m->len);
+    }
+    mem_maps = NULL;
+    mem_map_bytes = 0;
     mem_brk = mem_start_brk;
+    mem_peak = 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap, decommits the released pages and
+ *    returns the old brk.
  */
 void *mem_sbrk(int incr) 
 {
     char *old_brk = mem_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if ((incr < 0) && ((mem_brk + incr) < mem_start_brk)) {
+	errno = EINVAL;
+	fprintf(stderr, "ERROR: mem_sbrk failed. Shrunk below the heap start...\n");
+	return (void *)-1;
+    }
+    if ((mem_brk + incr) > mem_max_addr - mem_map_bytes) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
+#if USE_MMAP_HEAP
+    /* commit the pages the new brk reaches, COMMIT_CHUNK at a time */
+    if ((mem_brk + incr) > mem_commit_brk) {
+	size_t len = (size_t)(mem_brk + incr - mem_commit_brk);
+
+	len = (len + COMMIT_CHUNK - 1) & ~(size_t)(COMMIT_CHUNK - 1);
+	if (len > (size_t)(mem_max_addr - mem_commit_brk))
+	    len = (size_t)(mem_max_addr - mem_commit_brk);
+	if (mprotect(mem_commit_brk, len, PROT_READ | PROT_WRITE) < 0) {
+	    fprintf(stderr, "ERROR: mem_sbrk failed. Could not commit pages...\n");
+	    return (void *)-1;
+	}
+	mem_commit_brk += len;
+    }
+#endif
     mem_brk += incr;
+    if (incr < 0)
+	mem_decommit(mem_brk, -incr);
+    if (mem_heapsize() > mem_peak)
+	mem_peak = mem_heapsize();
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - model of mmap. Maps a region of at least size bytes outside
+ *    the heap and returns its ALIGNMENT aligned start, or NULL if the
+ *    heap limit would be exceeded or mmap fails.
+ */
+void *mem_map(size_t size)
+{
+    size_t pagesize = mem_pagesize();
+    size_t len = (size + MAP_HDRSIZE + pagesize - 1) & ~(pagesize - 1);
+    map_t *m;
+
+    if ((size > mem_max_heap) || (mem_heapsize() + len > mem_max_heap)) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    m = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED)
+	return NULL;
+    m->len = len;
+    m->prev = NULL;
+    m->next = mem_maps;
+    if (mem_maps != NULL)
+	mem_maps->prev = m;
+    mem_maps = m;
+    mem_map_bytes += len;
+    if (mem_heapsize() > mem_peak)
+	mem_peak = mem_heapsize();
+    return (char *)m + MAP_HDRSIZE;
+}
+
+/*
+ * mem_remap - model of mremap. Resizes a region from mem_map to at least
+ *    size bytes, moving its pages rather than copying them if it cannot
+ *    grow in place. Returns the region's new start, or NULL (and leaves
+ *    the region as it was) on failure.
+ */
+void *mem_remap(void *ptr, size_t size)
+{
+    size_t pagesize = mem_pagesize();
+    size_t len = (size + MAP_HDRSIZE + pagesize - 1) & ~(pagesize - 1);
+    map_t *m = (map_t *)((char *)ptr - MAP_HDRSIZE), *n;
+
+    if (len == m->len)
+	return ptr;
+    if ((size > mem_max_heap) || (mem_heapsize() - m->len + len > mem_max_heap)) {
+	errno = ENOMEM;
+	return NULL;
+    }
+#ifdef MREMAP_MAYMOVE
+    n = mremap(m, m->len, len, MREMAP_MAYMOVE);
+    if (n == MAP_FAILED)
+	return NULL;
+#else
+    n = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (n == MAP_FAILED)
+	return NULL;
+    memcpy(n, m, (len < m->len) ? len : m->len);
+    munmap(m, m->len);
+#endif
+    /* The header moved with the pages; fix its neighbours' links */
+    if (n->prev != NULL)
+	n->prev->next = n;
+    else
+	mem_maps = n;
+    if (n->next != NULL)
+	n->next->prev = n;
+    mem_map_bytes += len - n->len;
+    n->len = len;
+    if (mem_heapsize() > mem_peak)
+	mem_peak = mem_heapsize();
+    return (char *)n + MAP_HDRSIZE;
+}
+
+/*
+ * mem_unmap - model of munmap. Gives a region from mem_map back to the OS.
+ */
+void mem_unmap(void *ptr)
+{
+    map_t *m = (map_t *)((char *)ptr - MAP_HDRSIZE);
+
+    if (m->prev != NULL)
+	m->prev->next = m->next;
+    else
+	mem_maps = m->next;
+    if (m->next != NULL)
+	m->next->prev = m->prev;
+    mem_map_bytes -= m->len;
+    munmap(m, m->len);
+}
+
+/*
+ * mem_mapped - return true if the bytes lo..hi lie inside one region
+ *    from mem_map. It walks every region, so it is meant for checking,
+ *    not for an allocator's fast path.
+ */
+int mem_mapped(void *lo, void *hi)
+{
+    map_t *m;
+
+    for (m = mem_maps; m != NULL; m = m->next)
+	if (((char *)lo >= (char *)m + MAP_HDRSIZE) && ((char *)hi < (char *)m + m->len))
+	    return 1;
+    return 0;
+}
+
+/*
+ * mem_decommit - model of madvise(MADV_DONTNEED). Gives the whole pages
+ *    inside [start, start+len) back to the OS; their contents become 
+ *    zero the next time they are touched.
+ */
+void mem_decommit(void *start, size_t len)
+{
+    size_t pagesize = mem_pagesize();
+    char *lo = (char *)(((size_t)start + pagesize - 1) & ~(pagesize - 1));
+    char *hi = (char *)(((size_t)start + len) & ~(pagesize - 1));
+
+    if (lo < hi)
+	madvise(lo, hi - lo, MADV_DONTNEED);
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -85,11 +292,20 @@ void *mem_heap_hi()
 }
 
 /*
- * mem_heapsize() - returns the heap size in bytes
+ * mem_heapsize() - returns the heap size in bytes, mapped regions included
  */
 size_t mem_heapsize() 
 {
-    return (size_t)(mem_brk - mem_start_brk);
+    return (size_t)(mem_brk - mem_start_brk) + mem_map_bytes;
+}
+
+/*
+ * mem_heappeak() - returns the largest heap size in bytes since the
+ *    last mem_reset_brk
+ */
+size_t mem_heappeak() 
+{
+    return mem_peak;
 }
 
 /*
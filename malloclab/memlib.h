@@ -1,11 +1,19 @@
 #include <unistd.h>
 
+int mem_setmax(size_t size);
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(int incr);
+void mem_decommit(void *start, size_t len);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
+size_t mem_heappeak(void);
 size_t mem_pagesize(void);
 
+void *mem_map(size_t size);
+void *mem_remap(void *ptr, size_t size);
+void mem_unmap(void *ptr);
+int mem_mapped(void *lo, void *hi);
+
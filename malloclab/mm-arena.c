@@ -0,0 +1,677 @@
+/*
+ * mm-arena.c -  Thread-safe allocator with several arenas, per-thread
+ *               caches of small blocks and lock-free remote frees.
+ *
+ * Each block has header and footer of the form:
+ *
+ *      31                     3  2  1  0
+ *      -----------------------------------
+ *     | s  s  s  s  ... s  s  s  0  0  a/f
+ *      -----------------------------------
+ *
+ * where s are the meaningful size bits and a/f is set
+ * iff the block is allocated. Free blocks keep prev/next pointers
+ * in the first two payload words.
+ *
+ * Every arena owns a list of segments taken from mem_sbrk, each a
+ * multiple of SEG_SIZE bytes, and size-class free lists for them.
+ * A segment has the following form:
+ *
+ * begin                                                          end
+ * segment                                                    segment
+ *  -----------------------------------------------------------------
+ * |  next  | hdr(8:a) | ftr(8:a) | zero or more usr blks | hdr(0:a) |
+ *  -----------------------------------------------------------------
+ *          |       prologue      |                       | epilogue |
+ *
+ * seg_owner records which arena each SEG_SIZE unit of the heap belongs
+ * to, so free can find the owning arena of any block.
+ *
+ * A thread is assigned to an arena by hashing its thread id, and keeps
+ * a tcache: up to TC_COUNT blocks of each of the TC_BINS smallest sizes
+ * that malloc and free use without taking any lock. Blocks in a tcache
+ * stay allocated as far as their arena is concerned. Other frees lock
+ * the owning arena if it is the thread's own arena, or push the block
+ * onto the owner's remote-free stack with a compare-and-swap. The owner
+ * drains that stack under its lock the next time it allocates.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+/* Team structure (this should be one-man team, meaning that you are the only member of the team) */
+team_t team = {
+    "arena tcache",
+    "오치현", "2021029889", /* your name and student id in quote */
+    "", "",
+    1 /* 스레드마다 아레나를 두므로 -j로 돌릴 수 있다 */
+};
+
+/* $begin mallocmacros */
+/* Basic constants and macros */
+#define WSIZE       (ALIGNMENT/2) /* word size (bytes), 8 in 64-bit builds */
+#define DSIZE       ALIGNMENT     /* doubleword size (bytes) */
+#define DDSIZE      (2*ALIGNMENT) /* doubledoubleword size (bytes) */
+#define SEG_SIZE    (1<<16)  /* segment size unit (bytes) */
+#define OVERHEAD    (2*WSIZE)     /* overhead of header and footer (bytes) */
+
+#define NARENAS     4       /* number of arenas */
+#define NBINS       20      /* size classes per arena, by power of two */
+#define TC_BINS     16      /* tcache classes: DDSIZE ~ DDSIZE+(TC_BINS-1)*DSIZE bytes */
+#define TC_COUNT    7       /* blocks kept per tcache class */
+#define FIT_SCAN    16      /* blocks scanned in the own class before larger classes */
+
+#define MAX(x, y) ((x) > (y)? (x) : (y))
+#define MIN(x, y) ((x) < (y)? (x) : (y))
+
+/* Pack a size and allocated bit into a word */
+#define PACK(size, alloc)  ((size) | (alloc))
+
+/* Read and write a word at address p */
+#define GET(p)       (*(size_t *)(p))
+#define PUT(p, val)  (*(size_t *)(p) = (val))
+
+/* Read the size and allocated fields from address p */
+#define GET_SIZE(p)  (GET(p) & ~0x7)
+#define GET_ALLOC(p) (GET(p) & 0x1)
+
+/* Given block ptr bp, compute address of its header and footer */
+#define HDRP(bp)       ((char *)(bp) - WSIZE)
+#define FTRP(bp)       ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
+
+/* Given block ptr bp, compute address of next and previous blocks */
+#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
+#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
+
+/* 프리리스트에 연결된 노드의 다음 또는 이전 프리 블록 포인터 반환 */
+#define GET_NEXT(bp)    (*(void**)((char *)(bp) + WSIZE))
+#define GET_PREV(bp)    (*(void**)(bp))
+
+/* 세그먼트의 다음 세그먼트 포인터와 첫 블록 */
+#define SEG_NEXT(s)     (*(void**)(s))
+#define SEG_FIRST(s)    ((char *)(s) + DDSIZE)
+
+/* 블록이 속한 SEG_SIZE 단위 번호와 그 단위를 가진 아레나 */
+#define SEG_IDX(p)      ((size_t)((char *)(p) - (char *)mem_heap_lo()) / SEG_SIZE)
+#define ARENA_OF(p)     (&arenas[seg_owner[SEG_IDX(p)]])
+
+/* 2를 밑으로 하는 로그 (내림), 가장 낮은 1 비트의 위치 */
+#define LOG2(x)         ((sizeof(unsigned long)<<3) - 1 - __builtin_clzl((unsigned long)(x)))
+#define FFS(x)          ((size_t)__builtin_ctzl((unsigned long)(x)))
+
+/* 블록 크기의 클래스 번호 */
+#define BIN(size)       MIN(LOG2(size) - LOG2(DDSIZE), NBINS - 1)
+#define TC_IDX(size)    (((size) - DDSIZE) / DSIZE)
+
+/* 2 워드 사이즈 단위로 올림 */
+#define ALIGN(size)     (DSIZE * ((size + DDSIZE - 1) / DSIZE))
+/* $end mallocmacros */
+
+/* An arena: free lists of its segments, guarded by lock */
+typedef struct {
+    pthread_mutex_t lock;
+    void *bins[NBINS];       /* free list heads */
+    size_t bitmap;           /* bit b set iff bins[b] != NULL */
+    void *segs;              /* segment list */
+    void *remote;            /* blocks freed by threads of other arenas */
+} arena_t;
+
+/* A thread's cache of small blocks */
+typedef struct {
+    unsigned long gen;       /* heap generation the cache belongs to */
+    arena_t *arena;          /* arena assigned to the thread */
+    void *bins[TC_BINS];
+    int counts[TC_BINS];
+} tcache_t;
+
+/* Global variables */
+static arena_t arenas[NARENAS];
+static unsigned char seg_owner[MAX_HEAP_LIMIT / SEG_SIZE];  /* 단위별 아레나 번호 */
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;  /* memlib 은 스레드 안전하지 않음 */
+static unsigned long heap_gen;  /* mm_init 마다 증가 */
+static pthread_key_t tc_key;
+static pthread_once_t tc_once = PTHREAD_ONCE_INIT;
+static __thread tcache_t tcache;
+
+/* function prototypes for internal helper routines */
+static tcache_t *get_tcache(void);
+static void tc_key_init(void);
+static void tc_flush(void *arg);
+static void fork_prepare(void);
+static void fork_release(void);
+static void *extend_heap(arena_t *a, size_t asize);
+static void place(arena_t *a, void *bp, size_t asize);
+static void *find_fit(arena_t *a, size_t asize);
+static void *coalesce(arena_t *a, void *bp);
+static void free_block(arena_t *a, void *bp);
+static void remote_free(arena_t *a, void *bp);
+static void drain_remote(arena_t *a);
+static void insert(arena_t *a, void *bp);
+static void escape(arena_t *a, void *bp);
+static void printblock(void *bp);
+static void checkblock(void *bp);
+
+/*
+ * mm_init - Initialize the memory manager. Must not run concurrently
+ *           with any other mm_* call.
+ */
+/* $begin mminit */
+int mm_init(void)
+{
+    int i;
+
+    for (i = 0; i < NARENAS; ++i) {
+        memset(arenas[i].bins, 0, sizeof(arenas[i].bins));
+        arenas[i].bitmap = 0;
+        arenas[i].segs = NULL;
+        arenas[i].remote = NULL;
+        pthread_mutex_init(&arenas[i].lock, NULL);
+    }
+    memset(seg_owner, 0, sizeof(seg_owner));
+    pthread_once(&tc_once, tc_key_init);
+
+    /* 이전 힙을 가리키는 tcache 는 모두 무효 */
+    ++heap_gen;
+    return 0;
+}
+/* $end mminit */
+
+/*
+ * mm_malloc - Allocate a block with at least size bytes of payload
+ */
+/* $begin mmmalloc */
+void *mm_malloc(size_t size)
+{
+    tcache_t *tc = get_tcache();
+    arena_t *a = tc->arena;
+    size_t asize, idx;
+    void *bp;
+
+    if (size == 0)
+	return NULL;
+
+    if (size <= DSIZE) { // 최소 할당 사이즈는 4 워드
+        asize = DDSIZE;
+    } else {
+        asize = ALIGN(size);
+    }
+
+    /* 작은 블록은 락 없이 tcache 에서 */
+    idx = TC_IDX(asize);
+    if (idx < TC_BINS && tc->bins[idx] != NULL) {
+        bp = tc->bins[idx];
+        tc->bins[idx] = GET_PREV(bp);
+        --tc->counts[idx];
+        return bp;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    drain_remote(a);
+    if ((bp = find_fit(a, asize)) == NULL)
+        bp = extend_heap(a, asize);
+    if (bp != NULL)
+        place(a, bp, asize);
+    pthread_mutex_unlock(&a->lock);
+    return bp;
+}
+/* $end mmmalloc */
+
+/*
+ * mm_free - Free a block
+ */
+/* $begin mmfree */
+void mm_free(void *bp)
+{
+    tcache_t *tc;
+    arena_t *a;
+    size_t idx;
+
+    if (bp == NULL)
+        return;
+
+    /* 작은 블록은 tcache 가 차지 않았으면 tcache 로 */
+    tc = get_tcache();
+    idx = TC_IDX(GET_SIZE(HDRP(bp)));
+    if (idx < TC_BINS && tc->counts[idx] < TC_COUNT) {
+        GET_PREV(bp) = tc->bins[idx];
+        tc->bins[idx] = bp;
+        ++tc->counts[idx];
+        return;
+    }
+
+    /* 다른 아레나의 블록은 그 아레나의 원격 프리 스택으로 */
+    a = ARENA_OF(bp);
+    if (a != tc->arena) {
+        remote_free(a, bp);
+        return;
+    }
+    pthread_mutex_lock(&a->lock);
+    free_block(a, bp);
+    pthread_mutex_unlock(&a->lock);
+}
+/* $end mmfree */
+
+/*
+ * mm_realloc - grow in place into the next free block when possible,
+ *              otherwise allocate, copy and free
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+    size_t asize, csize, nsize;
+    arena_t *a;
+    void *next, *new_ptr;
+
+    // 포인터가 널이면, malloc 과 같은 동작을 한다.
+    if (ptr == NULL)
+        return mm_malloc(size);
+
+    // 사이즈가 0이면 free 와 같은 동작을 한다.
+    if (size == 0) {
+        mm_free(ptr);
+        return NULL;
+    }
+
+    asize = (size <= DSIZE) ? DDSIZE : ALIGN(size);
+    csize = GET_SIZE(HDRP(ptr));
+
+    // 현재 블록에 들어가면 그대로 반환한다.
+    if (asize <= csize)
+        return ptr;
+
+    /* 다음 블록이 프리이고 합쳐서 들어가면 제자리에서 늘림 */
+    a = ARENA_OF(ptr);
+    pthread_mutex_lock(&a->lock);
+    next = NEXT_BLKP(ptr);
+    nsize = GET_SIZE(HDRP(next));
+    if (!GET_ALLOC(HDRP(next)) && csize + nsize >= asize) {
+        escape(a, next);
+        PUT(HDRP(ptr), PACK(csize + nsize, 1));
+        PUT(FTRP(ptr), PACK(csize + nsize, 1));
+        if (csize + nsize - asize >= DDSIZE) {
+            PUT(HDRP(ptr), PACK(asize, 1));
+            PUT(FTRP(ptr), PACK(asize, 1));
+            next = NEXT_BLKP(ptr);
+            PUT(HDRP(next), PACK(csize + nsize - asize, 0));
+            PUT(FTRP(next), PACK(csize + nsize - asize, 0));
+            insert(a, next);
+        }
+        pthread_mutex_unlock(&a->lock);
+        return ptr;
+    }
+    pthread_mutex_unlock(&a->lock);
+
+    if ((new_ptr = mm_malloc(size)) == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, csize - OVERHEAD);
+    mm_free(ptr);
+    return new_ptr;
+}
+
+/*
+ * mm_usable_size - 할당된 블록에서 실제로 쓸 수 있는 바이트 수를 반환한다.
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if (ptr == NULL) {
+        return 0;
+    }
+    return GET_SIZE(HDRP(ptr)) - OVERHEAD;
+}
+
+/*
+ * mm_checkheap - Check the heap for consistency. Must not run
+ *                concurrently with any other mm_* call.
+ */
+void mm_checkheap(int verbose)
+{
+    int i;
+    size_t b, nfree, nlist;
+    arena_t *a;
+    char *s, *bp;
+
+    for (i = 0; i < NARENAS; ++i) {
+        a = &arenas[i];
+        nfree = nlist = 0;
+
+        if (verbose)
+            printf("Arena %d:\n", i);
+
+        for (s = a->segs; s != NULL; s = SEG_NEXT(s)) {
+            if (ARENA_OF(s) != a)
+                printf("Error: segment %p is not owned by arena %d\n", s, i);
+            if ((GET_SIZE(HDRP(SEG_FIRST(s) - DSIZE)) != DSIZE) || !GET_ALLOC(HDRP(SEG_FIRST(s) - DSIZE)))
+                printf("Bad prologue header\n");
+
+            for (bp = SEG_FIRST(s); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+                if (verbose)
+                    printblock(bp);
+                checkblock(bp);
+                if (!GET_ALLOC(HDRP(bp))) {
+                    ++nfree;
+                    if (!GET_ALLOC(HDRP(NEXT_BLKP(bp))))
+                        printf("Error: %p and the next block are both free\n", bp);
+                }
+            }
+            if (!GET_ALLOC(HDRP(bp)))
+                printf("Bad epilogue header\n");
+        }
+
+        /* 리스트의 블록이 모두 프리이고 클래스와 비트맵이 맞는지 테스트 */
+        for (b = 0; b < NBINS; ++b) {
+            if (((a->bitmap >> b) & 1) != (a->bins[b] != NULL))
+                printf("Bin %d 의 비트맵이 프리 리스트와 일치하지 않습니다.\n", (int)b);
+            for (bp = a->bins[b]; bp != NULL; bp = GET_NEXT(bp)) {
+                ++nlist;
+                if (GET_ALLOC(HDRP(bp)) || BIN(GET_SIZE(HDRP(bp))) != b)
+                    printf("Error: %p is in the wrong free list\n", bp);
+            }
+        }
+        if (nfree != nlist)
+            printf("Error: arena %d has %d free blocks but %d in its lists\n", i, (int)nfree, (int)nlist);
+    }
+}
+
+/* The remaining routines are internal helper routines */
+
+/*
+ * get_tcache - 호출한 스레드의 tcache. 처음이거나 힙이 다시 초기화되었으면
+ *              비우고 스레드 번호의 해시로 아레나를 정함
+ */
+static tcache_t *get_tcache(void)
+{
+    tcache_t *tc = &tcache;
+    size_t h;
+
+    if (tc->gen != heap_gen) {
+        memset(tc->bins, 0, sizeof(tc->bins));
+        memset(tc->counts, 0, sizeof(tc->counts));
+        /* 곱셈 해시로 정렬된 스레드 번호의 하위 비트 편중을 없앰 */
+        h = (size_t)pthread_self() * 2654435761u;
+        tc->arena = &arenas[(h >> 16) % NARENAS];
+        tc->gen = heap_gen;
+        pthread_setspecific(tc_key, tc);
+    }
+    return tc;
+}
+
+static void tc_key_init(void)
+{
+    pthread_key_create(&tc_key, tc_flush);
+}
+
+/*
+ * fork_prepare - fork 동안 모든 아레나 락과 mem_lock 을 잡아
+ *                자식이 잠긴 락을 물려받지 않게 함
+ *    락 순서는 extend_heap 과 같이 아레나 번호 순, 마지막이 mem_lock
+ */
+static void fork_prepare(void)
+{
+    int i;
+
+    for (i = 0; i < NARENAS; ++i)
+        pthread_mutex_lock(&arenas[i].lock);
+    pthread_mutex_lock(&mem_lock);
+}
+
+static void fork_release(void)
+{
+    int i;
+
+    pthread_mutex_unlock(&mem_lock);
+    for (i = NARENAS - 1; i >= 0; --i)
+        pthread_mutex_unlock(&arenas[i].lock);
+}
+
+/*
+ * fork_init - 핸들러를 적재 시점에 등록 (mm_init 안에서는 malloc 이
+ *             막혀 있을 수 있음). 우선순위를 주어 mmshim 보다 먼저
+ *             등록하면 prepare 는 mmshim 의 락을 잡은 뒤에 실행됨
+ */
+static void __attribute__((constructor(101))) fork_init(void)
+{
+    pthread_atfork(fork_prepare, fork_release, fork_release);
+}
+
+/*
+ * tc_flush - 스레드가 끝날 때 tcache 의 블록을 아레나로 돌려줌
+ */
+static void tc_flush(void *arg)
+{
+    tcache_t *tc = arg;
+    size_t idx;
+    void *bp;
+
+    if (tc->gen != heap_gen)
+        return;
+    for (idx = 0; idx < TC_BINS; ++idx) {
+        while ((bp = tc->bins[idx]) != NULL) {
+            tc->bins[idx] = GET_PREV(bp);
+            remote_free(ARENA_OF(bp), bp);
+        }
+        tc->counts[idx] = 0;
+    }
+}
+
+/*
+ * extend_heap - 아레나에 asize 바이트 블록이 들어가는 새 세그먼트를 붙이고
+ *               그 프리 블록을 반환
+ */
+/* $begin mmextendheap */
+static void *extend_heap(arena_t *a, size_t asize)
+{
+    size_t size, i;
+    char *s, *bp;
+
+    /* 세그먼트 앞뒤 오버헤드를 더해 SEG_SIZE 단위로 올림 */
+    size = (asize + DDSIZE + SEG_SIZE - 1) & ~(size_t)(SEG_SIZE - 1);
+
+    /* 모든 세그먼트가 SEG_SIZE 단위로 시작하도록 힙 전체에서 한 번에 하나씩 */
+    pthread_mutex_lock(&mem_lock);
+    if ((s = mem_sbrk(size)) == (void *)-1) {
+        pthread_mutex_unlock(&mem_lock);
+        return NULL;
+    }
+    for (i = 0; i < size / SEG_SIZE; ++i)
+        seg_owner[SEG_IDX(s) + i] = a - arenas;
+    pthread_mutex_unlock(&mem_lock);
+
+    SEG_NEXT(s) = a->segs;
+    a->segs = s;
+    PUT(s+WSIZE, PACK(DSIZE, 1));             /* prologue header */
+    PUT(s+DSIZE, PACK(DSIZE, 1));             /* prologue footer */
+    bp = SEG_FIRST(s);
+    PUT(HDRP(bp), PACK(size - DDSIZE, 0));    /* free block header */
+    PUT(FTRP(bp), PACK(size - DDSIZE, 0));    /* free block footer */
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));     /* epilogue header */
+
+    insert(a, bp);
+    return bp;
+}
+/* $end mmextendheap */
+
+/*
+ * place - Place block of asize bytes at start of free block bp
+ *         and split if remainder would be at least minimum block size
+ */
+/* $begin mmplace */
+static void place(arena_t *a, void *bp, size_t asize)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+
+    escape(a, bp);
+    if ((csize - asize) >= DDSIZE) {
+        PUT(HDRP(bp), PACK(asize, 1));
+        PUT(FTRP(bp), PACK(asize, 1));
+        bp = NEXT_BLKP(bp);
+        PUT(HDRP(bp), PACK(csize-asize, 0));
+        PUT(FTRP(bp), PACK(csize-asize, 0));
+        insert(a, bp);
+    }
+    else {
+        PUT(HDRP(bp), PACK(csize, 1));
+        PUT(FTRP(bp), PACK(csize, 1));
+    }
+}
+/* $end mmplace */
+
+/*
+ * find_fit - 같은 클래스에서 FIT_SCAN 개까지 first fit, 없으면 비어있지 않은 더 큰
+ *            클래스의 첫 블록, 그것도 없으면 같은 클래스의 나머지를 탐색.
+ *            락을 잡는 시간이 리스트 길이에 비례하지 않도록 탐색 수를 제한
+ */
+static void *find_fit(arena_t *a, size_t asize)
+{
+    size_t b = BIN(asize);
+    size_t bitmap;
+    void *bp;
+    int n;
+
+    for (bp = a->bins[b], n = 0; bp != NULL && n < FIT_SCAN; bp = GET_NEXT(bp), ++n) {
+        if (asize <= GET_SIZE(HDRP(bp)))
+            return bp;
+    }
+
+    bitmap = a->bitmap & ~(((size_t)2 << b) - 1);
+    if (bitmap != 0)
+        return a->bins[FFS(bitmap)];
+
+    for ( ; bp != NULL; bp = GET_NEXT(bp)) {
+        if (asize <= GET_SIZE(HDRP(bp)))
+            return bp;
+    }
+    return NULL;
+}
+
+/*
+ * coalesce - boundary tag coalescing. Return ptr to coalesced block
+ */
+static void *coalesce(arena_t *a, void *bp)
+{
+    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (prev_alloc && next_alloc) {            /* Case 1 */
+    }
+
+    else if (prev_alloc && !next_alloc) {      /* Case 2 */
+	escape(a, NEXT_BLKP(bp));
+	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+	PUT(HDRP(bp), PACK(size, 0));
+	PUT(FTRP(bp), PACK(size,0));
+    }
+
+    else if (!prev_alloc && next_alloc) {      /* Case 3 */
+	escape(a, PREV_BLKP(bp));
+	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
+	PUT(FTRP(bp), PACK(size, 0));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+	bp = PREV_BLKP(bp);
+    }
+
+    else {                                     /* Case 4 */
+	escape(a, NEXT_BLKP(bp));
+	escape(a, PREV_BLKP(bp));
+	size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
+	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+	bp = PREV_BLKP(bp);
+    }
+
+    insert(a, bp);
+    return bp;
+}
+
+/* 아레나의 락을 잡은 상태에서 블록을 프리로 만들고 병합 */
+static void free_block(arena_t *a, void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+    coalesce(a, bp);
+}
+
+/* 아레나의 원격 프리 스택에 블록을 넣음 (락 없음) */
+static void remote_free(arena_t *a, void *bp)
+{
+    void *head = __atomic_load_n(&a->remote, __ATOMIC_RELAXED);
+
+    do {
+        GET_PREV(bp) = head;
+    } while (!__atomic_compare_exchange_n(&a->remote, &head, bp, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* 아레나의 락을 잡은 상태에서 원격 프리 스택을 비우고 블록을 모두 프리로 */
+static void drain_remote(arena_t *a)
+{
+    void *bp, *next;
+
+    if (__atomic_load_n(&a->remote, __ATOMIC_RELAXED) == NULL)
+        return;
+    for (bp = __atomic_exchange_n(&a->remote, NULL, __ATOMIC_ACQUIRE); bp != NULL; bp = next) {
+        next = GET_PREV(bp);
+        free_block(a, bp);
+    }
+}
+
+/* LIFO */
+/* 클래스 프리리스트에 프리 블록을 삽입 */
+static void insert(arena_t *a, void *bp)
+{
+    size_t b = BIN(GET_SIZE(HDRP(bp)));
+
+    GET_PREV(bp) = NULL;
+    GET_NEXT(bp) = a->bins[b];
+    if (a->bins[b] != NULL)
+        GET_PREV(a->bins[b]) = bp;
+    a->bins[b] = bp;
+    a->bitmap |= (size_t)1 << b;
+}
+
+/* 클래스 프리리스트에서 프리 블록을 제외 */
+static void escape(arena_t *a, void *bp)
+{
+    size_t b = BIN(GET_SIZE(HDRP(bp)));
+
+    if (GET_PREV(bp) != NULL)
+        GET_NEXT(GET_PREV(bp)) = GET_NEXT(bp);
+    else if ((a->bins[b] = GET_NEXT(bp)) == NULL)
+        a->bitmap &= ~((size_t)1 << b);
+    if (GET_NEXT(bp) != NULL)
+        GET_PREV(GET_NEXT(bp)) = GET_PREV(bp);
+}
+
+static void printblock(void *bp)
+{
+    size_t hsize, halloc, fsize, falloc;
+
+    hsize = GET_SIZE(HDRP(bp));
+    halloc = GET_ALLOC(HDRP(bp));
+    fsize = GET_SIZE(FTRP(bp));
+    falloc = GET_ALLOC(FTRP(bp));
+
+    if (hsize == 0) {
+	printf("%p: EOL\n", bp);
+	return;
+    }
+
+    printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp,
+	   (int)hsize, (halloc ? 'a' : 'f'),
+	   (int)fsize, (falloc ? 'a' : 'f'));
+}
+
+static void checkblock(void *bp)
+{
+    if ((size_t)bp % ALIGNMENT)
+	printf("Error: %p is not %d-byte aligned\n", bp, ALIGNMENT);
+    if (GET(HDRP(bp)) != GET(FTRP(bp)))
+	printf("Error: header does not match footer\n");
+}
@@ -6,11 +6,13 @@
  * 
  *      31                     3  2  1  0 
  *      -----------------------------------
- *     | s  s  s  s  ... s  s  s  0  0  a/f
+ *     | s  s  s  s  ... s  s  s  0 p/a a/f
  *      ----------------------------------- 
  * 
  * where s are the meaningful size bits and a/f is set 
- * iff the block is allocated. The list has the following form:
+ * iff the block is allocated. With NO_FOOTER, only free blocks
+ * carry a footer and p/a is set iff the previous block is allocated.
+ * The list has the following form:
  *
  * begin                                                          end
  * heap                                                           heap  
@@ -29,12 +31,19 @@
 #include <stdlib.h>
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 /*
  * If NEXT_FIT defined use next fit search, else use first fit search 
  */
 #define NEXT_FIT 1
 
+/*
+ * If NO_FOOTER defined, allocated blocks have no footer and bit 1 of
+ * each header tells whether the previous block is allocated
+ */
+#define NO_FOOTER
+
 /* Team structure (this should be one-man team, meaning that you are the only member of the team) */
 team_t team = {
 #ifdef NEXT_FIT
@@ -51,21 +60,33 @@ team_t team = {
 #define WSIZE       4       /* word size (bytes) */  
 #define DSIZE       8       /* doubleword size (bytes) */
 #define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
-#define OVERHEAD    8       /* overhead of header and footer (bytes) */
+#ifdef NO_FOOTER
+#define OVERHEAD    WSIZE   /* overhead of header (bytes) */
+#define PALLOC      0x2     /* 이전 블록이 할당되었음을 나타내는 헤더 비트 */
+#else
+#define OVERHEAD    DSIZE   /* overhead of header and footer (bytes) */
+#define PALLOC      0
+#endif
+
+#define MINBLOCK    (DSIZE<<1)  /* 헤더, 두 링크, 푸터가 들어가는 최소 블록 (bytes) */
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))  
 #define MIN(x, y) ((x) < (y)? (x) : (y))  
 
+/* 블록 크기는 ALIGNMENT 의 배수. 태그는 ALIGNMENT 와 상관없이 4 바이트 */
+#define ALIGN(size)  (((size) + (ALIGNMENT-1)) & ~(size_t)(ALIGNMENT-1))
+
 /* Pack a size and allocated bit into a word */
 #define PACK(size, alloc)  ((size) | (alloc))
 
 /* Read and write a word at address p */
-#define GET(p)       (*(size_t *)(p))
-#define PUT(p, val)  (*(size_t *)(p) = (val))  
+#define GET(p)       (*(unsigned *)(p))
+#define PUT(p, val)  (*(unsigned *)(p) = (val))  
 
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PALLOC(p) (GET(p) & 0x2)
 
 /* Given block ptr bp, compute address of its header and footer */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)  
@@ -75,12 +96,43 @@ team_t team = {
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-#define NEXT(bp) (*(void **)((char *)(bp) + WSIZE))
-#define PREV(bp) (*(void **)(bp))
+/* 이전 블록의 할당 여부. 푸터가 없으면 PREV_BLKP 는 이전 블록이 프리일 때만 유효 */
+#ifdef NO_FOOTER
+#define PREV_ALLOC(bp) GET_PALLOC(HDRP(bp))
+#else
+#define PREV_ALLOC(bp) GET_ALLOC((char *)(bp) - DSIZE)
+#endif
+
+/*
+ * 프리 블록의 이전, 다음 링크는 힙 시작 (mem_heap_lo) 으로부터의 32 비트 오프셋.
+ * 힙은 MAX_HEAP_LIMIT 을 넘지 않으므로 항상 들어가고, 64 비트에서도 헤더, 두 링크, 푸터가
+ * 16 바이트 최소 블록에 들어간다.
+ * 리스트는 원형이라 링크가 NULL 인 경우는 없음
+ */
+#define ENCODE(p)       ((unsigned)((char *)(p) - heap_lo))
+#define DECODE(off)     ((void *)(heap_lo + (off)))
+#define PREV(bp)        DECODE(((unsigned *)(bp))[0])
+#define NEXT(bp)        DECODE(((unsigned *)(bp))[1])
+#define SET_PREV(bp, p) (((unsigned *)(bp))[0] = ENCODE(p))
+#define SET_NEXT(bp, p) (((unsigned *)(bp))[1] = ENCODE(p))
+
+/*
+ * MMAP_THRESHOLD 이상의 요청은 mem_map 으로 힙 밖에 따로 매핑한 블록에 할당한다.
+ *
+ *  | 패딩 | 매핑 길이 | 헤더 PACK(0, 1) | payload ... |
+ *
+ * 크기 0 인 할당 헤더는 힙의 블록에는 없는 태그이고, 힙 주소 범위 밖의 블록이 매핑된 블록이다.
+ * payload 가 정렬되도록 앞의 MAP_HDR 바이트를 패딩, 길이, 헤더에 쓴다.
+ */
+#define IS_MAPPED(p)    ((char *)(p) < heap_lo || (char *)(p) > (char *)mem_heap_hi())
+#define MAP_HDR         ALIGNMENT
+#define MAP_LEN(bp)     GET((char *)(bp) - DSIZE)
+#define MAP_TAG         PACK(0, 1)
 /* $end mallocmacros */
 
 /* Global variables */
 static char *heap_listp;  /* pointer to first block */  
+static char *heap_lo;     /* 링크 오프셋의 기준 주소 (mem_heap_lo) */
 #ifdef NEXT_FIT
 static char *rover;       /* next fit rover */
 #endif
@@ -90,8 +142,15 @@ static void *extend_heap(size_t words);
 static void place(void *bp, size_t asize);
 static void *find_fit(size_t asize);
 static void *coalesce(void *bp);
+static void trim(void *bp, char *lo, char *hi);
 static void printblock(void *bp); 
 static void checkblock(void *bp);
+static void set_alloc(void *bp, size_t size);
+static void set_free(void *bp, size_t size);
+static void escape_list(void *bp);
+static void insert_list(void *bp);
+static void *map_alloc(size_t size);
+static void *map_realloc(void *ptr, size_t size);
 
 /* 
  * mm_init - Initialize the memory manager 
@@ -101,14 +160,15 @@ int mm_init(void)
 {
     void *temp_heap_listp;
     /* create the initial empty heap */
+    heap_lo = mem_heap_lo();
     if ((temp_heap_listp = mem_sbrk((DSIZE<<2))) == (void *)-1)
 	return -1;
     PUT(temp_heap_listp, 0);                        /* alignment padding */
     PUT(temp_heap_listp+(WSIZE), PACK(DSIZE, 1));  /* prologue header */ 
     PUT(temp_heap_listp+(DSIZE), PACK(DSIZE, 1));  /* prologue footer */ 
-    PUT(temp_heap_listp+(DSIZE+WSIZE), PACK((DSIZE<<1), 0));  /* dummy header */ 
-    PUT(temp_heap_listp+(DSIZE<<1), temp_heap_listp+((DSIZE<<1)));  /* prev pointer */ 
-    PUT(temp_heap_listp+((DSIZE<<1)+WSIZE), temp_heap_listp+((DSIZE<<1)));  /* next pointer */ 
+    PUT(temp_heap_listp+(DSIZE+WSIZE), PACK((DSIZE<<1), PALLOC));  /* dummy header */ 
+    SET_PREV(temp_heap_listp+(DSIZE<<1), temp_heap_listp+(DSIZE<<1));  /* prev link */ 
+    SET_NEXT(temp_heap_listp+(DSIZE<<1), temp_heap_listp+(DSIZE<<1));  /* next link */ 
     PUT(temp_heap_listp+((DSIZE<<1)+DSIZE), PACK((DSIZE<<1), 0));  /* dummy footer */ 
     PUT(temp_heap_listp+((DSIZE<<1)+DSIZE+WSIZE), PACK(0, 1));  /* epilogue header */ 
     heap_listp = temp_heap_listp + (DSIZE<<1);
@@ -136,11 +196,16 @@ void *mm_malloc(size_t size)
 
     if (size == 0)
         return NULL;
+
+    /* 큰 요청은 따로 매핑해서 할당 */
+    if (size >= MMAP_THRESHOLD) {
+        return map_alloc(size);
+    }
     
-    if (size <= DSIZE) {
-        asize = (DSIZE<<1);
+    if (size + OVERHEAD <= MINBLOCK) {
+        asize = MINBLOCK;
     } else {
-        asize = DSIZE * ((size + (DSIZE<<1) - 1) / DSIZE);
+        asize = ALIGN(size + OVERHEAD);
     }
 
     if ((bp = find_fit(asize)) != NULL) {
@@ -171,10 +236,26 @@ void *mm_malloc(size_t size)
 /* $begin mmfree */
 void mm_free(void *bp)
 {
-    size_t size = GET_SIZE(HDRP(bp));
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
-    coalesce(bp);
+    char *lo = bp, *hi;
+
+    /* 매핑된 블록은 바로 반납 */
+    if (IS_MAPPED(bp)) {
+        mem_unmap((char *)bp - MAP_HDR);
+        return;
+    }
+    set_free(bp, GET_SIZE(HDRP(bp)));
+    /* 아직 반납되지 않은 범위는 이 블록과 DECOMMIT_THRESHOLD 보다 작은 프리
+       이웃. 그보다 큰 이웃은 이미 반납되어 맞닿은 페이지만 남아 있다 */
+    hi = NEXT_BLKP(bp);
+    if (!PREV_ALLOC(bp)) {
+        lo = (GET_SIZE(HDRP(PREV_BLKP(bp))) < DECOMMIT_THRESHOLD) ?
+            PREV_BLKP(bp) : lo - mem_pagesize();
+    }
+    if (!GET_ALLOC(HDRP(hi))) {
+        hi += (GET_SIZE(HDRP(hi)) < DECOMMIT_THRESHOLD) ?
+            GET_SIZE(HDRP(hi)) : mem_pagesize();
+    }
+    trim(coalesce(bp), lo, hi);
 }
 
 /* $end mmfree */
@@ -192,14 +273,24 @@ void *mm_realloc(void *ptr, size_t size)
     // 사이즈가 0이면 free 와 같은 동작을 한다.
     if (size == 0) {
         mm_free(ptr);
+        return NULL;
+    }
+
+    /* 힙 한도보다 큰 요청은 크기 계산이 넘칠 수 있으므로 바로 실패 */
+    if (size > MAX_HEAP_LIMIT) {
+        return NULL;
+    }
+
+    if (IS_MAPPED(ptr)) {
+        return map_realloc(ptr, size);
     }
 
     size_t csize = GET_SIZE(HDRP(ptr));
 
-    if (size <= DSIZE) {
-        size = 2*DSIZE;
+    if (size + OVERHEAD <= MINBLOCK) {
+        size = MINBLOCK;
     } else {
-        size = DSIZE * ((size + 2*DSIZE - 1) / DSIZE);
+        size = ALIGN(size + OVERHEAD);
     }
 
     // 사이즈가 같으면 다시 반환한다.
@@ -207,21 +298,20 @@ void *mm_realloc(void *ptr, size_t size)
         return ptr;
     }
 
-    size_t prev_alloc = GET_ALLOC(HDRP(PREV_BLKP(ptr)));
+    size_t prev_alloc = PREV_ALLOC(ptr);
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(ptr)));
     size_t next_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
-    size_t prev_size = GET_SIZE(HDRP(PREV_BLKP(ptr)));
+    size_t prev_size = prev_alloc ? 0 : GET_SIZE(HDRP(PREV_BLKP(ptr)));
     size_t new_cur = size - csize;
     size_t cur_new = csize - size;
+    void *new_ptr;
 
     /* CASE 1 */
     /* | ALLOC | ALLOC | ALLOC | */
     if (prev_alloc && next_alloc) {
-        if (size < csize && cur_new >= 4*WSIZE) {
-            PUT(HDRP(ptr), PACK(size, 1));
-            PUT(FTRP(ptr), PACK(size, 1));
-            PUT(HDRP(NEXT_BLKP(ptr)), PACK(cur_new, 0));
-            PUT(FTRP(NEXT_BLKP(ptr)), GET(HDRP(NEXT_BLKP(ptr))));
+        if (size < csize && cur_new >= MINBLOCK) {
+            set_alloc(ptr, size);
+            set_free(NEXT_BLKP(ptr), cur_new);
             insert_list(NEXT_BLKP(ptr));
             return ptr;
         }
@@ -231,19 +321,15 @@ void *mm_realloc(void *ptr, size_t size)
     /* | ALLOC | ALLOC | FREE | */
     else if (prev_alloc && !next_alloc) {
         if (size < csize) {
-            PUT(HDRP(ptr), PACK(size, 1));
-            PUT(FTRP(ptr), PACK(size, 1));
-            PUT(HDRP(NEXT_BLKP(ptr)), PACK(cur_new, 0));
-            PUT(FTRP(NEXT_BLKP(ptr)), GET(HDRP(NEXT_BLKP(ptr))));
+            set_alloc(ptr, size);
+            set_free(NEXT_BLKP(ptr), cur_new);
             coalesce(NEXT_BLKP(ptr));
             return ptr;
         }
-        else if ((next_size - new_cur) >= 4*WSIZE) {
+        else if (next_size >= new_cur && (next_size - new_cur) >= MINBLOCK) {
             escape_list(NEXT_BLKP(ptr));
-            PUT(HDRP(ptr), PACK(size, 1));
-            PUT(FTRP(ptr), PACK(size, 1));
-            PUT(HDRP(NEXT_BLKP(ptr)), PACK(next_size - new_cur, 0));
-            PUT(FTRP(NEXT_BLKP(ptr)), GET(HDRP(NEXT_BLKP(ptr))));
+            set_alloc(ptr, size);
+            set_free(NEXT_BLKP(ptr), next_size - new_cur);
             insert_list(NEXT_BLKP(ptr));
             return ptr;
         }
@@ -253,24 +339,21 @@ void *mm_realloc(void *ptr, size_t size)
     /* | FREE | ALLOC | ALLOC | */
     else if (!prev_alloc && next_alloc) {
         if (size < csize) {
-            PUT(HDRP(ptr), PACK(cur_new, 0));
-            memmove(NEXT_BLKP(ptr), ptr, size-DSIZE);
-            PUT(FTRP(ptr), GET(HDRP(ptr)));
-            PUT(HDRP(NEXT_BLKP(ptr)), PACK(size, 1));
-            PUT(FTRP(NEXT_BLKP(ptr)), PACK(size, 1));
-            ptr = NEXT_BLKP(ptr);
-            coalesce(PREV_BLKP(ptr));
-            return ptr;
+            new_ptr = (char *)ptr + cur_new;
+            memmove(new_ptr, ptr, size-OVERHEAD);
+            set_free(ptr, cur_new);
+            set_alloc(new_ptr, size);
+            coalesce(ptr);
+            return new_ptr;
         }
-        else if ((prev_size - new_cur) >= 4*WSIZE) {
-            escape_list(PREV_BLKP(ptr));
-            PUT(HDRP(PREV_BLKP(ptr)), PACK(prev_size - new_cur, 0));
-            PUT(FTRP(PREV_BLKP(ptr)), GET(HDRP(PREV_BLKP(ptr))));
-            void *new_ptr = NEXT_BLKP(PREV_BLKP(ptr));
-            memmove(new_ptr, ptr, csize-DSIZE);
-            PUT(HDRP(new_ptr), PACK(size, 1));
-            PUT(FTRP(new_ptr), PACK(size, 1));
-            insert_list(PREV_BLKP(new_ptr));
+        else if (prev_size >= new_cur && (prev_size - new_cur) >= MINBLOCK) {
+            void *prev_ptr = PREV_BLKP(ptr);
+            escape_list(prev_ptr);
+            set_free(prev_ptr, prev_size - new_cur);
+            new_ptr = NEXT_BLKP(prev_ptr);
+            memmove(new_ptr, ptr, csize-OVERHEAD);
+            set_alloc(new_ptr, size);
+            insert_list(prev_ptr);
             return new_ptr;
         }
     }
@@ -278,44 +361,55 @@ void *mm_realloc(void *ptr, size_t size)
     /* CASE 4 abc*/
     /* | FREE | ALLOC | FREE | */
     else if (!prev_alloc && !next_alloc) {
-        if ((prev_size + next_size - new_cur) >= 4*WSIZE) {
+        if (prev_size + next_size >= new_cur && (prev_size + next_size - new_cur) >= MINBLOCK) {
             size_t pnmn = prev_size + next_size - new_cur;
-            escape_list(PREV_BLKP(ptr));
+            void *prev_ptr = PREV_BLKP(ptr);
+            escape_list(prev_ptr);
             escape_list(NEXT_BLKP(ptr));
             if (size >= 100) {
-                PUT(HDRP(PREV_BLKP(ptr)), PACK(pnmn, 0));
-                void *new_ptr = NEXT_BLKP(PREV_BLKP(ptr));
-                memmove(new_ptr, ptr, size-DSIZE);
-                PUT(new_ptr-DSIZE, PACK(pnmn, 0));
-                PUT(HDRP(new_ptr), PACK(size, 1));
-                PUT(FTRP(new_ptr), PACK(size, 1));
-                insert_list(PREV_BLKP(new_ptr));
+                new_ptr = (char *)prev_ptr + pnmn;
+                memmove(new_ptr, ptr, MIN(size, csize)-OVERHEAD);
+                set_free(prev_ptr, pnmn);
+                set_alloc(new_ptr, size);
+                insert_list(prev_ptr);
                 return new_ptr;
             } else {
-                void *new_ptr = PREV_BLKP(ptr);
-                PUT(HDRP(new_ptr), PACK(size, 1));
-                memmove(new_ptr, ptr, size-DSIZE);
-                PUT(FTRP(new_ptr), PACK(size, 1));
-                PUT(HDRP(NEXT_BLKP(new_ptr)), PACK(pnmn, 0));
-                PUT(FTRP(NEXT_BLKP(new_ptr)), PACK(pnmn, 0));
+                new_ptr = prev_ptr;
+                memmove(new_ptr, ptr, MIN(size, csize)-OVERHEAD);
+                set_alloc(new_ptr, size);
+                set_free(NEXT_BLKP(new_ptr), pnmn);
                 insert_list(NEXT_BLKP(new_ptr));
                 return new_ptr;
             }
         }
     }
 
-    void *new_ptr;
     if ((new_ptr = mm_malloc(size)) == NULL) {
         return NULL;
     }
 
-    memmove(new_ptr, ptr, MIN(size, csize)-DSIZE);
+    memmove(new_ptr, ptr, MIN(size, csize)-OVERHEAD);
 
     mm_free(ptr);
 
     return new_ptr;
 }
 
+/*
+ * mm_usable_size - 할당된 블록에서 실제로 쓸 수 있는 바이트 수를 반환한다.
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if (ptr == NULL) {
+        return 0;
+    }
+    /* 매핑된 블록은 길이 워드와 헤더를 뺀 만큼 쓸 수 있다 */
+    if (IS_MAPPED(ptr)) {
+        return MAP_LEN(ptr) - MAP_HDR;
+    }
+    return GET_SIZE(HDRP(ptr)) - OVERHEAD;
+}
+
 /* 
  * mm_checkheap - Check the heap for consistency 
  */
@@ -353,14 +447,13 @@ static void *extend_heap(size_t words)
     char *bp;
     size_t size;
 	
-    /* Allocate an even number of words to maintain alignment */
-    size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
+    /* Allocate a multiple of ALIGNMENT bytes to maintain alignment */
+    size = ALIGN(words * WSIZE);
     if ((bp = mem_sbrk(size)) == (void *)-1) 
 	return NULL;
 
     /* Initialize free block header/footer and the epilogue header */
-    PUT(HDRP(bp), PACK(size, 0));         /* free block header */
-    PUT(FTRP(bp), PACK(size, 0));         /* free block footer */
+    set_free(bp, size);                   /* free block header/footer */
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
 
     /* Coalesce if the previous block was free */
@@ -368,6 +461,41 @@ static void *extend_heap(size_t words)
 }
 /* $end mmextendheap */
 
+/*
+ * trim - 큰 프리 블록의 메모리를 반납. 힙 끝의 블록이 TRIM_THRESHOLD 이상이면
+ *        CHUNKSIZE 만 남기고 힙을 줄이고, 중간의 블록이 DECOMMIT_THRESHOLD 
+ *        이상이면 내부 페이지 중 [lo, hi) 에 든 것만 반납. 이미 반납된 큰
+ *        이웃을 합칠 때마다 그 페이지를 다시 반납하지 않도록 mm_free 가
+ *        새로 프리된 범위를 넘겨준다
+ */
+static void trim(void *bp, char *lo, char *hi)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *start = (char *)bp + DSIZE;
+    char *end = (char *)bp + size - DSIZE;
+
+    if (GET_SIZE(HDRP(NEXT_BLKP(bp))) != 0) {
+        /* 헤더, 리스트 포인터, 푸터가 있는 페이지는 남김 */
+        if (size >= DECOMMIT_THRESHOLD) {
+            start = (lo > start) ? lo : start;
+            end = (hi < end) ? hi : end;
+            if (start < end) {
+                mem_decommit(start, end - start);
+            }
+        }
+        return;
+    }
+    if (size < TRIM_THRESHOLD) {
+        return;
+    }
+
+    escape_list(bp);
+    set_free(bp, CHUNKSIZE);
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
+    mem_sbrk(-(int)(size - CHUNKSIZE));
+    insert_list(bp);
+}
+
 /* 
  * place - Place block of asize bytes at start of free block bp 
  *         and split if remainder would be at least minimum block size
@@ -381,29 +509,66 @@ static void place(void *bp, size_t asize)
     size_t csize = GET_SIZE(HDRP(bp));   
     size_t remainer = csize - asize;
 
-    if (remainer <= (DSIZE<<1)) {
-	    PUT(HDRP(bp), PACK(csize, 1));
-    	PUT(FTRP(bp), PACK(csize, 1));
+    if (remainer < MINBLOCK) {
+        set_alloc(bp, csize);
     }
 
     else if (asize >= 100) {
-        PUT(HDRP(bp), PACK(remainer, 0));
-        PUT(FTRP(bp), PACK(remainer, 0));
-        PUT(HDRP(NEXT_BLKP(bp)), PACK(asize, 1));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(asize, 1));
+        set_free(bp, remainer);
+        set_alloc(NEXT_BLKP(bp), asize);
         insert_list(bp);
     }
     else {
-        PUT(HDRP(bp), PACK(asize, 1));
-        PUT(FTRP(bp), PACK(asize, 1));
-        PUT(HDRP(NEXT_BLKP(bp)), PACK(remainer, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(remainer, 0));
+        set_alloc(bp, asize);
+        set_free(NEXT_BLKP(bp), remainer);
         insert_list(NEXT_BLKP(bp));
     }
 }
 /* $end mmplace */
 
-void escape_list(void *bp) {
+/*
+ * map_alloc - size 바이트 요청을 힙 밖에 따로 매핑한 블록에 할당
+ */
+static void *map_alloc(size_t size)
+{
+    size_t len = ALIGN(size + MAP_HDR);  /* 길이 워드와 헤더 포함 */
+    char *p;
+
+    /* 힙 한도보다 큰 요청은 len 계산이 넘칠 수 있으므로 바로 실패 */
+    if (size > MAX_HEAP_LIMIT || (p = mem_map(len)) == NULL) {
+        return NULL;
+    }
+    PUT(p + MAP_HDR - DSIZE, len);
+    PUT(p + MAP_HDR - WSIZE, MAP_TAG);
+    return p + MAP_HDR;
+}
+
+/*
+ * map_realloc - 매핑된 블록의 크기를 바꾼다. 계속 큰 블록이면 mem_remap 으로 바이트 대신
+ *               페이지 테이블을 옮기고, 작아지면 힙에 새로 할당해서 복사한 뒤 매핑을 반납
+ */
+static void *map_realloc(void *ptr, size_t size)
+{
+    size_t len = ALIGN(size + MAP_HDR);
+    char *p;
+    void *new_ptr;
+
+    if (size >= MMAP_THRESHOLD) {
+        if ((p = mem_remap((char *)ptr - MAP_HDR, len)) == NULL) {
+            return NULL;
+        }
+        PUT(p + MAP_HDR - DSIZE, len);
+        return p + MAP_HDR;
+    }
+    if ((new_ptr = mm_malloc(size)) == NULL) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, size);
+    mem_unmap((char *)ptr - MAP_HDR);
+    return new_ptr;
+}
+
+static void escape_list(void *bp) {
     void **temp_heap_listp = &heap_listp;
     if (bp == *temp_heap_listp) {
         if (bp == NEXT(bp)) {
@@ -418,23 +583,23 @@ void escape_list(void *bp) {
         rover = NEXT(bp);
     }
 
-    NEXT(PREV(bp)) = NEXT(bp);
-    PREV(NEXT(bp)) = PREV(bp);
+    SET_NEXT(PREV(bp), NEXT(bp));
+    SET_PREV(NEXT(bp), PREV(bp));
 }
 
-void insert_list(void *bp) {
+static void insert_list(void *bp) {
     void **temp_heap_listp = &heap_listp;
     if (*temp_heap_listp == NULL) {
-        NEXT(bp) = bp;
-        PREV(bp) = bp;
+        SET_NEXT(bp, bp);
+        SET_PREV(bp, bp);
         rover = *temp_heap_listp = bp;
         return;
     }
 
-    NEXT(bp) = *temp_heap_listp;
-    PREV(bp) = PREV(*temp_heap_listp);
-    PREV(NEXT(bp)) = bp;
-    NEXT(PREV(bp)) = bp;
+    SET_NEXT(bp, *temp_heap_listp);
+    SET_PREV(bp, PREV(*temp_heap_listp));
+    SET_PREV(NEXT(bp), bp);
+    SET_NEXT(PREV(bp), bp);
     *temp_heap_listp = bp;
 }
 
@@ -484,7 +649,7 @@ static void *find_fit(size_t asize)
  */
 static void *coalesce(void *bp) 
 {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+    size_t prev_alloc = PREV_ALLOC(bp);
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     size_t size = GET_SIZE(HDRP(bp));
 
@@ -496,26 +661,23 @@ static void *coalesce(void *bp)
     else if (prev_alloc && !next_alloc) {      /* Case 2 */
     escape_list(NEXT_BLKP(bp));
 	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-	PUT(HDRP(bp), PACK(size, 0));
-	PUT(FTRP(bp), PACK(size,0));
+	set_free(bp, size);
     }
 
     else if (!prev_alloc && next_alloc) {      /* Case 3 */
     escape_list(PREV_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-	PUT(FTRP(bp), PACK(size, 0));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
 	bp = PREV_BLKP(bp);
+	set_free(bp, size);
     }
 
     else {                                     /* Case 4 */
     escape_list(NEXT_BLKP(bp));
     escape_list(PREV_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
-	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+	    GET_SIZE(HDRP(NEXT_BLKP(bp)));
 	bp = PREV_BLKP(bp);
+	set_free(bp, size);
     }
 
 #ifdef NEXT_FIT
@@ -545,17 +707,54 @@ static void printblock(void *bp)
     }
 
     printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp, 
-	   hsize, (halloc ? 'a' : 'f'), 
-	   fsize, (falloc ? 'a' : 'f')); 
+	   (int)hsize, (halloc ? 'a' : 'f'), 
+	   (int)fsize, (falloc ? 'a' : 'f')); 
 }
 
 static void checkblock(void *bp) 
 {
-    if ((size_t)bp % 8)
-	printf("Error: %p is not doubleword aligned\n", bp);
+    if ((size_t)bp % ALIGNMENT)
+	printf("Error: %p is not %d-byte aligned\n", bp, ALIGNMENT);
+#ifdef NO_FOOTER
+    /* 푸터는 프리 블록에만 있음 */
+    if (!GET_ALLOC(HDRP(bp)) && 
+        (GET_SIZE(HDRP(bp)) != GET_SIZE(FTRP(bp)) || GET_ALLOC(FTRP(bp))))
+#else
     if (GET(HDRP(bp)) != GET(FTRP(bp)))
+#endif
 	printf("Error: header does not match footer\n");
 }
 
+/*
+ * set_alloc - bp 를 size 바이트 할당 블록으로 기록. 
+ *             푸터가 없으면 헤더의 이전 블록 할당 비트를 유지하고 다음 블록 헤더에 표시
+ */
+static void set_alloc(void *bp, size_t size)
+{
+#ifdef NO_FOOTER
+    PUT(HDRP(bp), PACK(size, GET_PALLOC(HDRP(bp)) | 1));
+    PUT(HDRP(NEXT_BLKP(bp)), GET(HDRP(NEXT_BLKP(bp))) | PALLOC);
+#else
+    PUT(HDRP(bp), PACK(size, 1));
+    PUT(FTRP(bp), PACK(size, 1));
+#endif
+}
+
+/*
+ * set_free - bp 를 size 바이트 프리 블록으로 기록. 
+ *            푸터가 없으면 헤더의 이전 블록 할당 비트를 유지하고 다음 블록 헤더에서 지움
+ */
+static void set_free(void *bp, size_t size)
+{
+#ifdef NO_FOOTER
+    PUT(HDRP(bp), PACK(size, GET_PALLOC(HDRP(bp))));
+    PUT(FTRP(bp), PACK(size, 0));
+    PUT(HDRP(NEXT_BLKP(bp)), GET(HDRP(NEXT_BLKP(bp))) & ~PALLOC);
+#else
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+#endif
+}
+
 
 
@@ -6,11 +6,13 @@
  * 
  *      31                     3  2  1  0 
  *      -----------------------------------
- *     | s  s  s  s  ... s  s  s  0  0  a/f
+ *     | s  s  s  s  ... s  s  s  0 p/a a/f
  *      ----------------------------------- 
  * 
  * where s are the meaningful size bits and a/f is set 
- * iff the block is allocated. The list has the following form:
+ * iff the block is allocated. With NO_FOOTER, only free blocks
+ * carry a footer and p/a is set iff the previous block is allocated.
+ * The list has the following form:
  *
  * begin                                                          end
  * heap                                                           heap  
@@ -29,12 +31,19 @@
 #include <stdlib.h>
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 /*
  * If NEXT_FIT defined use next fit search, else use first fit search 
  */
 #define NEXT_FIT 1
 
+/*
+ * If NO_FOOTER defined, allocated blocks have no footer and bit 1 of
+ * each header tells whether the previous block is allocated
+ */
+#define NO_FOOTER
+
 /* Team structure (this should be one-man team, meaning that you are the only member of the team) */
 team_t team = {
 #ifdef NEXT_FIT
@@ -48,10 +57,16 @@ team_t team = {
 
 /* $begin mallocmacros */
 /* Basic constants and macros */
-#define WSIZE       4       /* word size (bytes) */  
-#define DSIZE       8       /* doubleword size (bytes) */
+#define WSIZE       (ALIGNMENT/2) /* word size (bytes), 8 in 64-bit builds */  
+#define DSIZE       ALIGNMENT     /* doubleword size (bytes) */
 #define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
-#define OVERHEAD    8       /* overhead of header and footer (bytes) */
+#ifdef NO_FOOTER
+#define OVERHEAD    WSIZE         /* overhead of header (bytes) */
+#define PALLOC      0x2     /* 이전 블록이 할당되었음을 나타내는 헤더 비트 */
+#else
+#define OVERHEAD    (2*WSIZE)     /* overhead of header and footer (bytes) */
+#define PALLOC      0
+#endif
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))  
 #define MIN(x, y) ((x) < (y)? (x) : (y))  
@@ -66,6 +81,7 @@ team_t team = {
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PALLOC(p) (GET(p) & 0x2)
 
 /* Given block ptr bp, compute address of its header and footer */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)  
@@ -75,6 +91,13 @@ team_t team = {
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
+/* 이전 블록의 할당 여부. 푸터가 없으면 PREV_BLKP 는 이전 블록이 프리일 때만 유효 */
+#ifdef NO_FOOTER
+#define PREV_ALLOC(bp) GET_PALLOC(HDRP(bp))
+#else
+#define PREV_ALLOC(bp) GET_ALLOC((char *)(bp) - DSIZE)
+#endif
+
 #define NEXT(bp) (*(void **)((char *)(bp) + WSIZE))
 #define PREV(bp) (*(void **)(bp))
 /* $end mallocmacros */
@@ -90,8 +113,13 @@ static void *extend_heap(size_t words);
 static void place(void *bp, size_t asize);
 static void *find_fit(size_t asize);
 static void *coalesce(void *bp);
+static void trim(void *bp, char *lo, char *hi);
 static void printblock(void *bp); 
 static void checkblock(void *bp);
+static void set_alloc(void *bp, size_t size);
+static void set_free(void *bp, size_t size);
+static void escape_list(void *bp);
+static void insert_list(void *bp);
 
 /* 
  * mm_init - Initialize the memory manager 
@@ -106,7 +134,7 @@ int mm_init(void)
     PUT(temp_heap_listp, 0);                        /* alignment padding */
     PUT(temp_heap_listp+(WSIZE), PACK(DSIZE, 1));  /* prologue header */ 
     PUT(temp_heap_listp+(DSIZE), PACK(DSIZE, 1));  /* prologue footer */ 
-    PUT(temp_heap_listp+(DSIZE+WSIZE), PACK((DSIZE<<1), 0));  /* dummy header */ 
+    PUT(temp_heap_listp+(DSIZE+WSIZE), PACK((DSIZE<<1), PALLOC));  /* dummy header */ 
     PUT(temp_heap_listp+(DSIZE<<1), temp_heap_listp+((DSIZE<<1)));  /* prev pointer */ 
     PUT(temp_heap_listp+((DSIZE<<1)+WSIZE), temp_heap_listp+((DSIZE<<1)));  /* next pointer */ 
     PUT(temp_heap_listp+((DSIZE<<1)+DSIZE), PACK((DSIZE<<1), 0));  /* dummy footer */ 
@@ -140,7 +168,7 @@ void *mm_malloc(size_t size)
     if (size <= DSIZE) {
         asize = (DSIZE<<1);
     } else {
-        asize = DSIZE * ((size + (DSIZE<<1) - 1) / DSIZE);
+        asize = DSIZE * ((size + OVERHEAD + DSIZE - 1) / DSIZE);
     }
 
     if ((bp = find_fit(asize)) != NULL) {
@@ -171,10 +199,21 @@ void *mm_malloc(size_t size)
 /* $begin mmfree */
 void mm_free(void *bp)
 {
-    size_t size = GET_SIZE(HDRP(bp));
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
-    coalesce(bp);
+    char *lo = bp, *hi;
+
+    set_free(bp, GET_SIZE(HDRP(bp)));
+    /* 아직 반납되지 않은 범위는 이 블록과 DECOMMIT_THRESHOLD 보다 작은 프리
+       이웃. 그보다 큰 이웃은 이미 반납되어 맞닿은 페이지만 남아 있다 */
+    hi = NEXT_BLKP(bp);
+    if (!PREV_ALLOC(bp)) {
+        lo = (GET_SIZE(HDRP(PREV_BLKP(bp))) < DECOMMIT_THRESHOLD) ?
+            PREV_BLKP(bp) : lo - mem_pagesize();
+    }
+    if (!GET_ALLOC(HDRP(hi))) {
+        hi += (GET_SIZE(HDRP(hi)) < DECOMMIT_THRESHOLD) ?
+            GET_SIZE(HDRP(hi)) : mem_pagesize();
+    }
+    trim(coalesce(bp), lo, hi);
 }
 
 /* $end mmfree */
@@ -199,7 +238,7 @@ void *mm_realloc(void *ptr, size_t size)
     if (size <= DSIZE) {
         size = (DSIZE<<1);
     } else {
-        size = DSIZE * ((size + (DSIZE<<1) - 1) / DSIZE);
+        size = DSIZE * ((size + OVERHEAD + DSIZE - 1) / DSIZE);
     }
     size_t remainder = csize - size;
 
@@ -210,12 +249,10 @@ void *mm_realloc(void *ptr, size_t size)
         size_t diffsize = size - csize;
         
         if (nsize >= diffsize + (DSIZE<<1)) {
-            PUT(HDRP(ptr), PACK(size, 1));
-            PUT(FTRP(ptr), PACK(size, 1));
+            set_alloc(ptr, size);
 
             void *new_next_block = NEXT_BLKP(ptr);
-            PUT(HDRP(new_next_block), PACK(nsize - diffsize, 0));
-            PUT(FTRP(new_next_block), PACK(nsize - diffsize, 0));
+            set_free(new_next_block, nsize - diffsize);
 
             if (heap_listp == next_block) {
                 heap_listp = new_next_block;
@@ -237,7 +274,7 @@ void *mm_realloc(void *ptr, size_t size)
     if ((new_ptr = mm_malloc(tempsize)) == NULL)
         return NULL; // 실패
     
-    size_t oldsize = GET_SIZE(HDRP(ptr)) - DSIZE; // 헤더와 푸터 뺌
+    size_t oldsize = GET_SIZE(HDRP(ptr)) - OVERHEAD; // 헤더와 푸터 뺌
 
     memmove(new_ptr, ptr, MIN(tempsize, oldsize)); // 값 복사
 
@@ -246,6 +283,17 @@ void *mm_realloc(void *ptr, size_t size)
     return new_ptr;
 }
 
+/*
+ * mm_usable_size - 할당된 블록에서 실제로 쓸 수 있는 바이트 수를 반환한다.
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if (ptr == NULL) {
+        return 0;
+    }
+    return GET_SIZE(HDRP(ptr)) - OVERHEAD;
+}
+
 /* 
  * mm_checkheap - Check the heap for consistency 
  */
@@ -289,8 +337,7 @@ static void *extend_heap(size_t words)
 	return NULL;
 
     /* Initialize free block header/footer and the epilogue header */
-    PUT(HDRP(bp), PACK(size, 0));         /* free block header */
-    PUT(FTRP(bp), PACK(size, 0));         /* free block footer */
+    set_free(bp, size);                   /* free block header/footer */
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
 
     /* Coalesce if the previous block was free */
@@ -298,6 +345,41 @@ static void *extend_heap(size_t words)
 }
 /* $end mmextendheap */
 
+/*
+ * trim - 큰 프리 블록의 메모리를 반납. 힙 끝의 블록이 TRIM_THRESHOLD 이상이면
+ *        CHUNKSIZE 만 남기고 힙을 줄이고, 중간의 블록이 DECOMMIT_THRESHOLD 
+ *        이상이면 내부 페이지 중 [lo, hi) 에 든 것만 반납. 이미 반납된 큰
+ *        이웃을 합칠 때마다 그 페이지를 다시 반납하지 않도록 mm_free 가
+ *        새로 프리된 범위를 넘겨준다
+ */
+static void trim(void *bp, char *lo, char *hi)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *start = (char *)bp + DSIZE;
+    char *end = (char *)bp + size - DSIZE;
+
+    if (GET_SIZE(HDRP(NEXT_BLKP(bp))) != 0) {
+        /* 헤더, 리스트 포인터, 푸터가 있는 페이지는 남김 */
+        if (size >= DECOMMIT_THRESHOLD) {
+            start = (lo > start) ? lo : start;
+            end = (hi < end) ? hi : end;
+            if (start < end) {
+                mem_decommit(start, end - start);
+            }
+        }
+        return;
+    }
+    if (size < TRIM_THRESHOLD) {
+        return;
+    }
+
+    escape_list(bp);
+    set_free(bp, CHUNKSIZE);
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
+    mem_sbrk(-(int)(size - CHUNKSIZE));
+    insert_list(bp);
+}
+
 /* 
  * place - Place block of asize bytes at start of free block bp 
  *         and split if remainder would be at least minimum block size
@@ -312,28 +394,23 @@ static void place(void *bp, size_t asize)
     size_t remainer = csize - asize;
 
     if (remainer <= (DSIZE<<1)) {
-	    PUT(HDRP(bp), PACK(csize, 1));
-    	PUT(FTRP(bp), PACK(csize, 1));
+        set_alloc(bp, csize);
     }
 
     else if (asize >= 100) {
-        PUT(HDRP(bp), PACK(remainer, 0));
-        PUT(FTRP(bp), PACK(remainer, 0));
-        PUT(HDRP(NEXT_BLKP(bp)), PACK(asize, 1));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(asize, 1));
+        set_free(bp, remainer);
+        set_alloc(NEXT_BLKP(bp), asize);
         insert_list(bp);
     }
     else {
-        PUT(HDRP(bp), PACK(asize, 1));
-        PUT(FTRP(bp), PACK(asize, 1));
-        PUT(HDRP(NEXT_BLKP(bp)), PACK(remainer, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(remainer, 0));
+        set_alloc(bp, asize);
+        set_free(NEXT_BLKP(bp), remainer);
         insert_list(NEXT_BLKP(bp));
     }
 }
 /* $end mmplace */
 
-void escape_list(void *bp) {
+static void escape_list(void *bp) {
     void **temp_heap_listp = &heap_listp;
     if (bp == *temp_heap_listp) {
         if (bp == NEXT(bp)) {
@@ -352,7 +429,7 @@ void escape_list(void *bp) {
     PREV(NEXT(bp)) = PREV(bp);
 }
 
-void insert_list(void *bp) {
+static void insert_list(void *bp) {
     void **temp_heap_listp = &heap_listp;
     if (*temp_heap_listp == NULL) {
         NEXT(bp) = bp;
@@ -414,7 +491,7 @@ static void *find_fit(size_t asize)
  */
 static void *coalesce(void *bp) 
 {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+    size_t prev_alloc = PREV_ALLOC(bp);
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     size_t size = GET_SIZE(HDRP(bp));
 
@@ -426,26 +503,23 @@ static void *coalesce(void *bp)
     else if (prev_alloc && !next_alloc) {      /* Case 2 */
     escape_list(NEXT_BLKP(bp));
 	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-	PUT(HDRP(bp), PACK(size, 0));
-	PUT(FTRP(bp), PACK(size,0));
+	set_free(bp, size);
     }
 
     else if (!prev_alloc && next_alloc) {      /* Case 3 */
     escape_list(PREV_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-	PUT(FTRP(bp), PACK(size, 0));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
 	bp = PREV_BLKP(bp);
+	set_free(bp, size);
     }
 
     else {                                     /* Case 4 */
     escape_list(NEXT_BLKP(bp));
     escape_list(PREV_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
-	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+	    GET_SIZE(HDRP(NEXT_BLKP(bp)));
 	bp = PREV_BLKP(bp);
+	set_free(bp, size);
     }
 
 #ifdef NEXT_FIT
@@ -475,16 +549,53 @@ static void printblock(void *bp)
     }
 
     printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp, 
-	   hsize, (halloc ? 'a' : 'f'), 
-	   fsize, (falloc ? 'a' : 'f')); 
+	   (int)hsize, (halloc ? 'a' : 'f'), 
+	   (int)fsize, (falloc ? 'a' : 'f')); 
 }
 
 static void checkblock(void *bp) 
 {
-    if ((size_t)bp % 8)
-	printf("Error: %p is not doubleword aligned\n", bp);
+    if ((size_t)bp % ALIGNMENT)
+	printf("Error: %p is not %d-byte aligned\n", bp, ALIGNMENT);
+#ifdef NO_FOOTER
+    /* 푸터는 프리 블록에만 있음 */
+    if (!GET_ALLOC(HDRP(bp)) && 
+        (GET_SIZE(HDRP(bp)) != GET_SIZE(FTRP(bp)) || GET_ALLOC(FTRP(bp))))
+#else
     if (GET(HDRP(bp)) != GET(FTRP(bp)))
+#endif
 	printf("Error: header does not match footer\n");
 }
 
+/*
+ * set_alloc - bp 를 size 바이트 할당 블록으로 기록. 
+ *             푸터가 없으면 헤더의 이전 블록 할당 비트를 유지하고 다음 블록 헤더에 표시
+ */
+static void set_alloc(void *bp, size_t size)
+{
+#ifdef NO_FOOTER
+    PUT(HDRP(bp), PACK(size, GET_PALLOC(HDRP(bp)) | 1));
+    PUT(HDRP(NEXT_BLKP(bp)), GET(HDRP(NEXT_BLKP(bp))) | PALLOC);
+#else
+    PUT(HDRP(bp), PACK(size, 1));
+    PUT(FTRP(bp), PACK(size, 1));
+#endif
+}
+
+/*
+ * set_free - bp 를 size 바이트 프리 블록으로 기록. 
+ *            푸터가 없으면 헤더의 이전 블록 할당 비트를 유지하고 다음 블록 헤더에서 지움
+ */
+static void set_free(void *bp, size_t size)
+{
+#ifdef NO_FOOTER
+    PUT(HDRP(bp), PACK(size, GET_PALLOC(HDRP(bp))));
+    PUT(FTRP(bp), PACK(size, 0));
+    PUT(HDRP(NEXT_BLKP(bp)), GET(HDRP(NEXT_BLKP(bp))) & ~PALLOC);
+#else
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+#endif
+}
+
 
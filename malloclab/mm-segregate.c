@@ -6,11 +6,13 @@
  * 
  *      31                     3  2  1  0 
  *      -----------------------------------
- *     | s  s  s  s  ... s  s  s  0  0  a/f
+ *     | s  s  s  s  ... s  s  s  0 p/a a/f
  *      ----------------------------------- 
  * 
  * where s are the meaningful size bits and a/f is set 
- * iff the block is allocated. The list has the following form:
+ * iff the block is allocated. With NO_FOOTER, only free blocks
+ * carry a footer and p/a is set iff the previous block is allocated.
+ * The list has the following form:
  *
  * begin                                                          end
  * heap                                                           heap  
@@ -29,12 +31,19 @@
 #include <stdlib.h>
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 /*
  * If NEXT_FIT defined use next fit search, else use first fit search 
  */
 #define NEXT_FITx
 
+/*
+ * If NO_FOOTER defined, allocated blocks have no footer and bit 1 of
+ * each header tells whether the previous block is allocated
+ */
+#define NO_FOOTER
+
 /* Team structure (this should be one-man team, meaning that you are the only member of the team) */
 team_t team = {
 #ifdef NEXT_FIT
@@ -51,8 +60,16 @@ team_t team = {
 #define WSIZE       4       /* word size (bytes) */  
 #define DSIZE       8       /* doubleword size (bytes) */
 #define DDSIZE      16       /* doubledoubleword size (bytes) */
+#define PSIZE       sizeof(void *)  /* 프롤로그와 런 헤더에 담는 포인터, 비트맵 워드 크기 (bytes) */
 #define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
+#ifdef NO_FOOTER
+#define OVERHEAD    4       /* overhead of header (bytes) */
+#define PALLOC      0x2     /* 이전 블록이 할당되었음을 나타내는 헤더 비트 */
+#else
 #define OVERHEAD    8       /* overhead of header and footer (bytes) */
+#define PALLOC      0
+#endif
+#define REALLOCED   0x4     /* 할당 블록이 realloc 으로 커진 적이 있음 (프리 블록에서는 mm_checkheap 의 표시) */
 #define RANK0       (WSIZE<<3)      /* Rank 0 의 범위는 4 ~ 8 워드 입니다. */
 #define RANK1       (WSIZE<<4)      /* Rank 1 의 범위는 10 ~ 16 워드 입니다. */
 #define RANK2       (RANK0 | RANK1)      /* Rank 2 의 범위는 18 ~ 24 워드 입니다. */
@@ -62,8 +79,15 @@ team_t team = {
 #define RANK6       (WSIZE<<8)      /* Rank 6 의 범위는 130 ~ 256 워드 입니다. */
 #define RANK7       (WSIZE<<9)      /* Rank 7 의 범위는 258 ~ 512 워드 입니다. */
 #define RANK8       (WSIZE<<10)      /* Rank 8 의 범위는 514 ~ 1024 워드 입니다. */
-                                    /* Rank 9 의 범위는 1026 ~ INF 워드 입니다. */
+                                    /* Rank 9 의 범위는 1026 ~ INF 워드 입니다. (스플레이 트리) */
 #define RANKSIZE    10
+#define RANKSHIFT   (LOG2(RANK3) - 3)   /* Rank 3 이후 계층은 2의 거듭제곱 단위 */
+#define RUN_SIZE    (1<<12)         /* 슬랩 런 하나의 크기 (페이지) */
+#define SLAB_MAX    (ALIGNMENT<<4)  /* 이 크기 이하의 요청은 슬랩에서 할당 */
+#define SLAB_CLASSES (SLAB_MAX/ALIGNMENT)  /* ALIGNMENT 간격의 슬랩 크기 계층 수 */
+
+/* 프롤로그 블록은 계층 헤더, 비트맵, 슬랩 런 리스트 헤더를 담고, 첫 블록이 정렬되도록 크기를 맞춤 */
+#define PROLOGUE_SIZE ALIGN_UP((RANKSIZE+1+SLAB_CLASSES)*PSIZE + DSIZE)
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))  
 #define MIN(x, y) ((x) < (y)? (x) : (y))  
@@ -72,12 +96,13 @@ team_t team = {
 #define PACK(size, alloc)  ((size) | (alloc))
 
 /* Read and write a word at address p */
-#define GET(p)       (*(size_t *)(p))
-#define PUT(p, val)  (*(size_t *)(p) = (val))  
+#define GET(p)       (*(unsigned *)(p))
+#define PUT(p, val)  (*(unsigned *)(p) = (val))  
 
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PALLOC(p) (GET(p) & 0x2)
 
 /* Given block ptr bp, compute address of its header and footer */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)  
@@ -87,34 +112,140 @@ team_t team = {
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-/* 프리리스트에 연결된 노드의 다음 또는 이전 프리 블록 포인터 반환 */
-#define GET_NEXT(bp)    (*(void**)((char *)(bp) + WSIZE))
-#define GET_PREV(bp)    (*(void**)(bp))
+/* 이전 블록의 할당 여부. 푸터가 없으면 PREV_BLKP 는 이전 블록이 프리일 때만 유효 */
+#ifdef NO_FOOTER
+#define PREV_ALLOC(bp) GET_PALLOC(HDRP(bp))
+#else
+#define PREV_ALLOC(bp) GET_ALLOC((char *)(bp) - DSIZE)
+#endif
+
+/*
+ * 프리 블록의 링크는 포인터 대신 힙 시작 (mem_heap_lo) 으로부터의 32 비트 오프셋으로
+ * 저장해 64 비트에서도 헤더, 두 링크, 푸터가 16 바이트 최소 블록에 들어간다. 힙은 MAX_HEAP_LIMIT 을 넘지 않고,
+ * 힙의 첫 워드는 블록이 될 수 없으므로 오프셋 0 은 NULL 을 뜻한다.
+ */
+#define ENCODE(p)       ((unsigned)((p) == NULL ? 0 : (char *)(p) - heap_lo))
+#define DECODE(off)     ((off) == 0 ? NULL : (void *)(heap_lo + (off)))
+#define GET_LINK(bp, i)    DECODE(((unsigned *)(bp))[i])
+#define SET_LINK(bp, i, p) (((unsigned *)(bp))[i] = ENCODE(p))
+
+/* 프리리스트에 연결된 노드의 다음 또는 이전 프리 블록 포인터 */
+#define GET_PREV(bp)    GET_LINK(bp, 0)
+#define GET_NEXT(bp)    GET_LINK(bp, 1)
+#define SET_PREV(bp, p) SET_LINK(bp, 0, p)
+#define SET_NEXT(bp, p) SET_LINK(bp, 1, p)
+
+/* 마지막 계층은 (크기, 주소) 를 키로 하는 스플레이 트리. 노드의 왼쪽, 오른쪽 자식 포인터 */
+#define GET_LEFT(bp)     GET_LINK(bp, 0)
+#define GET_RIGHT(bp)    GET_LINK(bp, 1)
+#define SET_LEFT(bp, p)  SET_LINK(bp, 0, p)
+#define SET_RIGHT(bp, p) SET_LINK(bp, 1, p)
+
+/* 프리리스트 계층에 해당하는 헤더 포인터 반환 (마지막 계층은 트리의 루트) */
+#define GET_RANK(rank)  (*(void**)((char *)(heap_listp) + (PSIZE*(rank))))
 
-/* 프리리스트 계층에 해당하는 헤더 포인터 반환 */
-#define GET_RANK(rank)  (*(void**)((char *)(heap_listp) + (WSIZE*rank)))
+/* 비어있지 않은 프리리스트 계층을 표시하는 비트맵 (프롤로그 안, 계층 헤더 바로 뒤) */
+#define GET_BITMAP()    (*(size_t *)((char *)(heap_listp) + (PSIZE*RANKSIZE)))
 
-/* 2 워드 사이즈 단위로 올림 */
-#define ALIGN(size)     (DSIZE * ((size + DDSIZE - 1) / DSIZE))
+/* 2를 밑으로 하는 로그 (내림), 가장 낮은 1 비트의 위치 */
+#define LOG2(x)         ((sizeof(unsigned long)<<3) - 1 - __builtin_clzl((unsigned long)(x)))
+#define FFS(x)          ((size_t)__builtin_ctzl((unsigned long)(x)))
+
+/* ALIGNMENT 단위로 올림. 블록 크기는 ALIGNMENT 의 배수이고, 태그는 ALIGNMENT 와 상관없이 4 바이트 */
+#define ALIGN_UP(size)  (ALIGNMENT * (((size) + ALIGNMENT - 1) / ALIGNMENT))
+
+/* 오버헤드를 포함해 ALIGNMENT 단위로 올림 */
+#define ALIGN(size)     ALIGN_UP((size) + OVERHEAD)
+
+/* 다시 커지는 블록에 주는 크기. 1.5 배씩 늘려 복사 비용을 바이트당 상수로 묶음 */
+#define GROW(size)      ALIGN_UP((size) + ((size) >> 1))
 /* $end mallocmacros */
 
+/*
+ * 슬랩 런은 힙 시작 주소 기준 RUN_SIZE 로 정렬된 할당 블록 하나를 통째로 사용하며,
+ * 같은 크기의 객체를 경계 태그 없이 담는다. 런의 앞부분은 다음과 같다.
+ *
+ *  | class | used | cap | next run | prev run | free bitmap ... | objects ... |
+ *
+ * 비트맵의 1 은 빈 객체를 뜻한다. 어떤 페이지가 런인지는 slab_map 으로 표시하므로
+ * mm_free 는 주소만으로 슬랩 객체와 경계 태그 블록을 구분한다.
+ */
+#define SLAB_CLASS(size)  (((size) + ALIGNMENT - 1) / ALIGNMENT - 1)
+#define SLAB_OBJSIZE(cls) (((cls) + 1) * ALIGNMENT)
+
+/* 프리리스트 계층 헤더 뒤에 오는, 빈 객체가 있는 런 리스트의 헤더 포인터 반환 */
+#define GET_SLAB(cls)   (*(void**)((char *)(heap_listp) + (PSIZE*(RANKSIZE+1+(cls)))))
+
+/* 런 헤더 필드. 객체가 정렬되도록 헤더 크기는 ALIGNMENT 단위로 올림 */
+#define RUN_CLASS(r)    (*(size_t *)(r))
+#define RUN_USED(r)     (*(size_t *)((char *)(r) + PSIZE))
+#define RUN_CAP(r)      (*(size_t *)((char *)(r) + 2*PSIZE))
+#define RUN_NEXT(r)     (*(void**)((char *)(r) + 3*PSIZE))
+#define RUN_PREV(r)     (*(void**)((char *)(r) + 4*PSIZE))
+#define RUN_MAP(r)      ((size_t *)((char *)(r) + 5*PSIZE))
+#define MAP_BITS        (PSIZE<<3)
+#define MAP_WORDS(cap)  (((cap) + MAP_BITS - 1) / MAP_BITS)
+#define RUN_HDRSIZE(cap) ALIGN_UP((5 + MAP_WORDS(cap))*PSIZE)
+
+/* 주소가 속한 런과 페이지 번호, 슬랩 여부 */
+#define PAGE_IDX(p)     ((size_t)((char *)(p) - (char *)mem_heap_lo()) / RUN_SIZE)
+#define RUN_OF(p)       ((char *)mem_heap_lo() + PAGE_IDX(p) * RUN_SIZE)
+#define IS_SLAB(p)      ((slab_map[PAGE_IDX(p) / MAP_BITS] >> (PAGE_IDX(p) % MAP_BITS)) & 1)
+
+/*
+ * MMAP_THRESHOLD 이상의 요청은 mem_map 으로 힙 밖에 따로 매핑한 블록에 할당한다.
+ *
+ *  | 패딩 | 매핑 길이 | 헤더 PACK(0, 1) | payload ... |
+ *
+ * 크기 0 인 할당 헤더는 힙의 블록에는 없는 태그이다. 힙 주소 범위 밖의 블록이 매핑된 블록이며,
+ * 슬랩 여부보다 먼저 검사해야 한다 (slab_map 은 힙 안의 주소만 다룬다).
+ * payload 가 정렬되도록 앞의 MAP_HDR 바이트를 패딩, 길이, 헤더에 쓴다.
+ */
+#define IS_MAPPED(p)    ((char *)(p) < heap_lo || (char *)(p) > (char *)mem_heap_hi())
+#define MAP_HDR         ALIGNMENT
+#define MAP_LEN(bp)     GET((char *)(bp) - DSIZE)
+#define MAP_TAG         PACK(0, 1)
+
 /* Global variables */
 static char *heap_listp;  /* pointer to first block */  
+static char *heap_lo;     /* 링크 오프셋의 기준 주소 (mem_heap_lo) */
 #ifdef NEXT_FIT
 static char *rover;       /* next fit rover */
 #endif
+static size_t slab_map[MAX_HEAP_LIMIT / RUN_SIZE / MAP_BITS + 1];  /* 슬랩 런인 페이지 표시 */
 
 /* function prototypes for internal helper routines */
 static void *extend_heap(size_t words);
 static void place(void *bp, size_t asize);
 static void *find_fit(size_t asize);
 static void *coalesce(void *bp);
+static void trim(void *bp, char *lo, char *hi);
 static void printblock(void *bp); 
 static void checkblock(void *bp);
-
-void escape(void *bp);
-void insert(void *bp);
-size_t getRank(size_t size);
+static void set_alloc(void *bp, size_t size);
+static void set_free(void *bp, size_t size);
+static void *resize(void *ptr, size_t size);
+
+static void escape(void *bp);
+static void insert(void *bp);
+static size_t getRank(size_t size);
+static void toggleMarkFreeBlock(void);
+
+static void *slab_alloc(size_t cls);
+static void slab_free(void *p);
+static void *new_run(size_t cls);
+static char *run_fit(char *bp, size_t size);
+
+static void *map_alloc(size_t size);
+static void *map_realloc(void *ptr, size_t size);
+
+static int tree_cmp(size_t size, char *addr, void *bp);
+static void *splay(void *t, size_t size, char *addr);
+static void tree_insert(void *bp);
+static void tree_remove(void *bp);
+static void *tree_fit(size_t asize);
+static void tree_toggle(void *bp);
+static void tree_check(void *bp, void *lo, void *hi);
 
 /* 
  * mm_init - Initialize the memory manager 
@@ -123,16 +254,15 @@ size_t getRank(size_t size);
 int mm_init(void) 
 {
     /* create the initial empty heap */
-    if ((heap_listp = mem_sbrk((RANKSIZE+4)*WSIZE)) == (void *)-1)
+    heap_lo = mem_heap_lo();
+    if ((heap_listp = mem_sbrk(ALIGNMENT + PROLOGUE_SIZE)) == (void *)-1)
 	return -1;
-    PUT(heap_listp, 0);                        /* alignment padding */
-    PUT(heap_listp+(1*WSIZE), PACK((RANKSIZE+2)*WSIZE, 1));  /* prologue header */ 
-    for (int i = 2; i - 2 < RANKSIZE; ++i) {
-        PUT(heap_listp+(i*WSIZE), NULL); /* 프리 리스트 포인터 */
-    }
-    PUT(heap_listp+((RANKSIZE+2)*WSIZE), PACK((RANKSIZE+2)*WSIZE, 1));  /* prologue footer */ 
-    PUT(heap_listp+((RANKSIZE+3)*WSIZE), PACK(0, 1));  /* epilogue header */ 
-    heap_listp += DSIZE;
+    memset(heap_listp, 0, ALIGNMENT + PROLOGUE_SIZE);  /* alignment padding, 계층 헤더, 비트맵, 슬랩 런 리스트 헤더 */
+    heap_listp += ALIGNMENT;
+    PUT(HDRP(heap_listp), PACK(PROLOGUE_SIZE, 1));  /* prologue header */ 
+    PUT(FTRP(heap_listp), PACK(PROLOGUE_SIZE, 1));  /* prologue footer */ 
+    PUT(HDRP(NEXT_BLKP(heap_listp)), PACK(0, 1 | PALLOC));  /* epilogue header */ 
+    memset(slab_map, 0, sizeof(slab_map));
 
 #ifdef NEXT_FIT
     rover = heap_listp;
@@ -155,6 +285,14 @@ void *mm_malloc(size_t size)
     size_t extendsize;
     void *bp;
 
+    /* 작은 요청은 슬랩에서, 큰 요청은 따로 매핑해서 할당 */
+    if (size > 0 && size <= SLAB_MAX) {
+        return slab_alloc(SLAB_CLASS(size));
+    }
+    if (size >= MMAP_THRESHOLD) {
+        return map_alloc(size);
+    }
+
     if (size <= DSIZE) { // 최소 할당 사이즈는 4 워드
         asize = DDSIZE;
     } else {
@@ -188,11 +326,31 @@ void *mm_malloc(size_t size)
 /* $begin mmfree */
 void mm_free(void *bp)
 {
-    size_t size = GET_SIZE(HDRP(bp));
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
+    char *lo = bp, *hi;
 
-    coalesce(bp);
+    /* 매핑된 블록은 바로 반납 */
+    if (IS_MAPPED(bp)) {
+        mem_unmap((char *)bp - MAP_HDR);
+        return;
+    }
+    if (IS_SLAB(bp)) {
+        slab_free(bp);
+        return;
+    }
+
+    set_free(bp, GET_SIZE(HDRP(bp)));
+    /* 아직 반납되지 않은 범위는 이 블록과 DECOMMIT_THRESHOLD 보다 작은 프리
+       이웃. 그보다 큰 이웃은 이미 반납되어 맞닿은 페이지만 남아 있다 */
+    hi = NEXT_BLKP(bp);
+    if (!PREV_ALLOC(bp)) {
+        lo = (GET_SIZE(HDRP(PREV_BLKP(bp))) < DECOMMIT_THRESHOLD) ?
+            PREV_BLKP(bp) : lo - mem_pagesize();
+    }
+    if (!GET_ALLOC(HDRP(hi))) {
+        hi += (GET_SIZE(HDRP(hi)) < DECOMMIT_THRESHOLD) ?
+            GET_SIZE(HDRP(hi)) : mem_pagesize();
+    }
+    trim(coalesce(bp), lo, hi);
 }
 
 /* $end mmfree */
@@ -210,9 +368,36 @@ void *mm_realloc(void *ptr, size_t size)
     // 사이즈가 0이면 free 와 같은 동작을 한다.
     if (size == 0) {
         mm_free(ptr);
+        return NULL;
+    }
+
+    /* 힙 한도보다 큰 요청은 크기 계산이 넘칠 수 있으므로 바로 실패 */
+    if (size > MAX_HEAP_LIMIT) {
+        return NULL;
+    }
+
+    if (IS_MAPPED(ptr)) {
+        return map_realloc(ptr, size);
+    }
+
+    /* 슬랩 객체는 같은 크기 계층이면 그대로, 아니면 새로 할당해서 복사 */
+    if (IS_SLAB(ptr)) {
+        size_t osize = SLAB_OBJSIZE(RUN_CLASS(RUN_OF(ptr)));
+        void *new_ptr;
+
+        if (size <= osize && SLAB_CLASS(size) == RUN_CLASS(RUN_OF(ptr))) {
+            return ptr;
+        }
+        if ((new_ptr = mm_malloc(size)) == NULL) {
+            return NULL;
+        }
+        memcpy(new_ptr, ptr, MIN(size, osize));
+        slab_free(ptr);
+        return new_ptr;
     }
 
     size_t csize = GET_SIZE(HDRP(ptr));
+    void *new_ptr;
 
     if (size <= DSIZE) {
         size = DDSIZE;
@@ -220,27 +405,75 @@ void *mm_realloc(void *ptr, size_t size)
         size = ALIGN(size);
     }
 
+    /* 전에 커진 적이 있는 블록은 여유 공간을 두고 다룬다. 절반 이상 남지 않으면 줄이지 않고,
+       다시 커지면 1.5 배 이상으로 키운다. 여유 공간은 블록의 일부이므로 free 하면 함께 반납됨 */
+    if (GET(HDRP(ptr)) & REALLOCED) {
+        if (size <= csize && csize - size <= (csize >> 1)) {
+            return ptr;
+        }
+        if (size > csize) {
+            size = MAX(size, GROW(csize));
+        }
+    }
+
     // 사이즈가 같으면 다시 반환한다.
     if (size == csize) {
         return ptr;
     }
 
-    size_t prev_alloc = GET_ALLOC(HDRP(PREV_BLKP(ptr)));
+    /* 커진 블록에 표시. 슬랩 객체와 매핑된 블록은 제외 */
+    if ((new_ptr = resize(ptr, size)) != NULL && size > csize &&
+        !IS_MAPPED(new_ptr) && !IS_SLAB(new_ptr)) {
+        PUT(HDRP(new_ptr), GET(HDRP(new_ptr)) | REALLOCED);
+    }
+    return new_ptr;
+}
+
+/*
+ * resize - 경계 태그 블록 ptr 을 정렬된 크기 size 로 바꾼다. 가능하면 이웃 블록을 이용해
+ *          제자리에서, 아니면 새로 할당해서 복사한다.
+ */
+static void *resize(void *ptr, size_t size)
+{
+    size_t csize = GET_SIZE(HDRP(ptr));
+    size_t prev_alloc = PREV_ALLOC(ptr);
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(ptr)));
     size_t next_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
-    size_t prev_size = GET_SIZE(HDRP(PREV_BLKP(ptr)));
+    size_t prev_size = prev_alloc ? 0 : GET_SIZE(HDRP(PREV_BLKP(ptr)));
     size_t new_cur = size - csize;
     size_t cur_new = csize - size;
+    void *new_ptr;
+
+    /* CASE 0 */
+    /* | ALLOC | (FREE) | EPILOGUE | */
+    /* 힙의 마지막 블록이면 모자란 만큼만 힙을 늘리고 복사 없이 제자리에서 키운다 */
+    if (size > csize && (next_size == 0 ||
+        (!next_alloc && GET_SIZE(HDRP(NEXT_BLKP(NEXT_BLKP(ptr)))) == 0))) {
+        size_t avail = csize + (next_alloc ? 0 : next_size);
+
+        /* 늘린 공간은 뒤의 프리 블록과 병합되어 ptr 바로 뒤의 프리 블록이 됨 */
+        if (avail < size && extend_heap((size - avail) / WSIZE) == NULL) {
+            return NULL;
+        }
+        next_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
+        escape(NEXT_BLKP(ptr));
+        if (csize + next_size - size >= DDSIZE) {
+            set_alloc(ptr, size);
+            set_free(NEXT_BLKP(ptr), csize + next_size - size);
+            insert(NEXT_BLKP(ptr));
+        } else {
+            set_alloc(ptr, csize + next_size);
+        }
+        return ptr;
+    }
 
     /* CASE 1 */
     /* | ALLOC | ALLOC | ALLOC | */
     if (prev_alloc && next_alloc) {
         /* 요구 사이즈가 현재 사이즈 보다 작고, 현재 할당 공간에서 분할할 때 남은 공간이 4 워드보다 큰 경우 */
         if (size < csize && cur_new >= DDSIZE) {
-            PUT(HDRP(ptr), PACK(size, 1));
-            PUT(FTRP(ptr), PACK(size, 1));
-            PUT(HDRP(NEXT_BLKP(ptr)), PACK(cur_new, 0));
-            PUT(FTRP(NEXT_BLKP(ptr)), GET(HDRP(NEXT_BLKP(ptr))));
+            set_alloc(ptr, size);
+            set_free(NEXT_BLKP(ptr), cur_new);
             insert(NEXT_BLKP(ptr));
             return ptr;
         }
@@ -251,20 +484,16 @@ void *mm_realloc(void *ptr, size_t size)
     else if (prev_alloc && !next_alloc) {
         /* 요구 사이즈가 현재 사이즈 보다 작은 경우, 현재 할당 공간에서 분할한 뒤, 다음 프리 블록과 병합 */
         if (size < csize) {
-            PUT(HDRP(ptr), PACK(size, 1));
-            PUT(FTRP(ptr), PACK(size, 1));
-            PUT(HDRP(NEXT_BLKP(ptr)), PACK(cur_new, 0));
-            PUT(FTRP(NEXT_BLKP(ptr)), GET(HDRP(NEXT_BLKP(ptr))));
+            set_alloc(ptr, size);
+            set_free(NEXT_BLKP(ptr), cur_new);
             coalesce(NEXT_BLKP(ptr));
             return ptr;
         }
         /* 요구 사이즈를 충족하기 위한 추가 사이즈 만큼의 공간을 다음 프리 블록에서 가져왔을 때 남은 프리 블록 공간이 4 워드 이상인 경우 */
-        else if ((next_size - new_cur) >= DDSIZE) {
+        else if (next_size >= new_cur && (next_size - new_cur) >= DDSIZE) {
             escape(NEXT_BLKP(ptr));
-            PUT(HDRP(ptr), PACK(size, 1));
-            PUT(FTRP(ptr), PACK(size, 1));
-            PUT(HDRP(NEXT_BLKP(ptr)), PACK(next_size - new_cur, 0));
-            PUT(FTRP(NEXT_BLKP(ptr)), GET(HDRP(NEXT_BLKP(ptr))));
+            set_alloc(ptr, size);
+            set_free(NEXT_BLKP(ptr), next_size - new_cur);
             insert(NEXT_BLKP(ptr));
             return ptr;
         }
@@ -275,25 +504,22 @@ void *mm_realloc(void *ptr, size_t size)
     else if (!prev_alloc && next_alloc) {
         /* 요구 사이즈가 현재 사이즈 보다 작은 경우, 현재 할당 공간에서 분할한 뒤, 이전 프리 블록과 병합 */
         if (size < csize) {
-            PUT(HDRP(ptr), PACK(cur_new, 0));
-            memmove(NEXT_BLKP(ptr), ptr, size-DSIZE);
-            PUT(FTRP(ptr), GET(HDRP(ptr)));
-            PUT(HDRP(NEXT_BLKP(ptr)), PACK(size, 1));
-            PUT(FTRP(NEXT_BLKP(ptr)), PACK(size, 1));
-            ptr = NEXT_BLKP(ptr);
-            coalesce(PREV_BLKP(ptr));
-            return ptr;
+            new_ptr = (char *)ptr + cur_new;
+            memmove(new_ptr, ptr, size-OVERHEAD);
+            set_free(ptr, cur_new);
+            set_alloc(new_ptr, size);
+            coalesce(ptr);
+            return new_ptr;
         }
         /* 요구 사이즈를 충족하기 위한 추가 사이즈 만큼의 공간을 이전 프리 블록에서 가져왔을 때 남은 프리 블록 공간이 4 워드 이상인 경우 */
-        else if ((prev_size - new_cur) >= DDSIZE) {
-            escape(PREV_BLKP(ptr));
-            PUT(HDRP(PREV_BLKP(ptr)), PACK(prev_size - new_cur, 0));
-            PUT(FTRP(PREV_BLKP(ptr)), GET(HDRP(PREV_BLKP(ptr))));
-            void *new_ptr = NEXT_BLKP(PREV_BLKP(ptr));
-            memmove(new_ptr, ptr, csize-DSIZE);
-            PUT(HDRP(new_ptr), PACK(size, 1));
-            PUT(FTRP(new_ptr), PACK(size, 1));
-            insert(PREV_BLKP(new_ptr));
+        else if (prev_size >= new_cur && (prev_size - new_cur) >= DDSIZE) {
+            void *prev_ptr = PREV_BLKP(ptr);
+            escape(prev_ptr);
+            set_free(prev_ptr, prev_size - new_cur);
+            new_ptr = NEXT_BLKP(prev_ptr);
+            memmove(new_ptr, ptr, csize-OVERHEAD);
+            set_alloc(new_ptr, size);
+            insert(prev_ptr);
             return new_ptr;
         }
     }
@@ -302,27 +528,24 @@ void *mm_realloc(void *ptr, size_t size)
     /* | FREE | ALLOC | FREE | */
     else if (!prev_alloc && !next_alloc) {
         /* 사이즈 변경 후 남은 양쪽 프리 블록을 포함해 크기가 4 워드 이상일 경우 */
-        if ((prev_size + next_size - new_cur) >= DDSIZE) {
+        if (prev_size + next_size >= new_cur && (prev_size + next_size - new_cur) >= DDSIZE) {
             size_t pnmn = prev_size + next_size - new_cur;
-            escape(PREV_BLKP(ptr));
+            void *prev_ptr = PREV_BLKP(ptr);
+            escape(prev_ptr);
             escape(NEXT_BLKP(ptr));
             /* 할당 공간이 25 워드를 넘어가는 경우, 뒤에 배치 */
             if (size >= 100) {
-                PUT(HDRP(PREV_BLKP(ptr)), PACK(pnmn, 0));
-                void *new_ptr = NEXT_BLKP(PREV_BLKP(ptr));
-                memmove(new_ptr, ptr, size-DSIZE);
-                PUT(new_ptr-DSIZE, PACK(pnmn, 0));
-                PUT(HDRP(new_ptr), PACK(size, 1));
-                PUT(FTRP(new_ptr), PACK(size, 1));
-                insert(PREV_BLKP(new_ptr));
+                new_ptr = (char *)prev_ptr + pnmn;
+                memmove(new_ptr, ptr, MIN(size, csize)-OVERHEAD);
+                set_free(prev_ptr, pnmn);
+                set_alloc(new_ptr, size);
+                insert(prev_ptr);
                 return new_ptr;
             } else { /* 넘어가지 않는 경우, 앞에 배치 */
-                void *new_ptr = PREV_BLKP(ptr);
-                PUT(HDRP(new_ptr), PACK(size, 1));
-                memmove(new_ptr, ptr, size-DSIZE);
-                PUT(FTRP(new_ptr), PACK(size, 1));
-                PUT(HDRP(NEXT_BLKP(new_ptr)), PACK(pnmn, 0));
-                PUT(FTRP(NEXT_BLKP(new_ptr)), PACK(pnmn, 0));
+                new_ptr = prev_ptr;
+                memmove(new_ptr, ptr, MIN(size, csize)-OVERHEAD);
+                set_alloc(new_ptr, size);
+                set_free(NEXT_BLKP(new_ptr), pnmn);
                 insert(NEXT_BLKP(new_ptr));
                 return new_ptr;
             }
@@ -330,19 +553,36 @@ void *mm_realloc(void *ptr, size_t size)
     }
 
     /* 위의 조건을 모두 만족하지 않는 경우, 최적의 공간 배치의 경우가 없는 것으로 간주하고 현재 블록을 해제 후 재할당 */
-    void *new_ptr;
     if ((new_ptr = mm_malloc(size)) == NULL) {
         return NULL;
     }
 
     /* memcpy를 사용해서 메모리에서 바로 복사 후 붙여넣기를 하는 것보다 memmove를 사용해서 기존 메모리 값을 버퍼에 복사 후 새로운 곳에 붙여넣기를 하는 것이 더 안정적임. */
-    memmove(new_ptr, ptr, MIN(size, csize)-DSIZE);
+    memmove(new_ptr, ptr, MIN(size, csize)-OVERHEAD);
 
     mm_free(ptr);
 
     return new_ptr;
 }
 
+/*
+ * mm_usable_size - 할당된 블록에서 실제로 쓸 수 있는 바이트 수를 반환한다.
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if (ptr == NULL) {
+        return 0;
+    }
+    /* 매핑된 블록은 길이 워드와 헤더를 뺀 만큼, 슬랩 객체는 크기 계층의 객체 크기만큼 쓸 수 있다 */
+    if (IS_MAPPED(ptr)) {
+        return MAP_LEN(ptr) - MAP_HDR;
+    }
+    if (IS_SLAB(ptr)) {
+        return SLAB_OBJSIZE(RUN_CLASS(RUN_OF(ptr)));
+    }
+    return GET_SIZE(HDRP(ptr)) - OVERHEAD;
+}
+
 /* 
  * mm_checkheap - Check the heap for consistency 
  */
@@ -353,10 +593,27 @@ void mm_checkheap(int verbose)
     if (verbose)
 	printf("Heap (%p):\n", heap_listp);
 
-    if ((GET_SIZE(HDRP(heap_listp)) != (RANKSIZE+2)*WSIZE) || !GET_ALLOC(HDRP(heap_listp)))
+    if ((GET_SIZE(HDRP(heap_listp)) != PROLOGUE_SIZE) || !GET_ALLOC(HDRP(heap_listp)))
 	printf("Bad prologue header\n");
     checkblock(heap_listp);
 
+    /* 비트맵과 프리 리스트가 일치하는지 테스트 */
+    for (size_t rank = 0; rank < RANKSIZE; ++rank) {
+        if (((GET_BITMAP() >> rank) & 1) != (GET_RANK(rank) != NULL))
+            printf("Rank %d 의 비트맵이 프리 리스트와 일치하지 않습니다.\n", (int)rank);
+    }
+
+    /* 트리의 키 순서와 노드 크기가 올바른지 테스트 */
+    tree_check(GET_RANK(RANKSIZE - 1), NULL, NULL);
+
+    /* 슬랩 런 리스트의 런이 올바른지 테스트 */
+    for (size_t cls = 0; cls < SLAB_CLASSES; ++cls) {
+        for (bp = GET_SLAB(cls); bp != NULL; bp = RUN_NEXT(bp)) {
+            if (!IS_SLAB(bp) || RUN_OF(bp) != bp || RUN_CLASS(bp) != cls || RUN_USED(bp) >= RUN_CAP(bp))
+                printf("Error: bad slab run %p in class %d\n", bp, (int)cls);
+        }
+    }
+
     /* 모든 프리 블록이 리스트에 있는지 테스트 */
     toggleMarkFreeBlock();
     for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
@@ -364,6 +621,11 @@ void mm_checkheap(int verbose)
             printf("프리 리스트에 없는 프리 블록이 존재합니다.\n");
             printblock(bp);
         }
+#ifdef NO_FOOTER
+        /* 다음 블록 헤더의 이전 블록 할당 비트가 맞는지 테스트 */
+        if (!GET_PALLOC(HDRP(NEXT_BLKP(bp))) != !GET_ALLOC(HDRP(bp)))
+            printf("Error: %p 다음 블록의 이전 블록 할당 비트가 잘못되었습니다.\n", bp);
+#endif
 	if (verbose) 
 	    printblock(bp);
 	checkblock(bp);
@@ -376,15 +638,16 @@ void mm_checkheap(int verbose)
 	printf("Bad epilogue header\n");
 }
 
-void toggleMarkFreeBlock() {
+static void toggleMarkFreeBlock(void) {
     size_t rank = 0;
     void *bp;
-    while (rank < RANKSIZE) {
+    while (rank < RANKSIZE - 1) {
         for (bp = GET_RANK(rank); bp != NULL; bp = GET_NEXT(bp)) {
             PUT(HDRP(bp), GET(HDRP(bp)) ^ 4);
         }
         ++rank;
     }
+    tree_toggle(GET_RANK(RANKSIZE - 1));
 }
 
 /* The remaining routines are internal helper routines */
@@ -398,14 +661,13 @@ static void *extend_heap(size_t words)
     char *bp;
     size_t size;
 	
-    /* Allocate an even number of words to maintain alignment */
-    size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
+    /* Allocate a multiple of ALIGNMENT bytes to maintain alignment */
+    size = ALIGN_UP(words * WSIZE);
     if ((bp = mem_sbrk(size)) == (void *)-1) 
 	return NULL;
 
     /* Initialize free block header/footer and the epilogue header */
-    PUT(HDRP(bp), PACK(size, 0));         /* free block header */
-    PUT(FTRP(bp), PACK(size, 0));         /* free block footer */
+    set_free(bp, size);                   /* free block header/footer */
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
 
     /* Coalesce if the previous block was free */
@@ -413,6 +675,41 @@ static void *extend_heap(size_t words)
 }
 /* $end mmextendheap */
 
+/*
+ * trim - 큰 프리 블록의 메모리를 반납. 힙 끝의 블록이 TRIM_THRESHOLD 이상이면
+ *        CHUNKSIZE 만 남기고 힙을 줄이고, 중간의 블록이 DECOMMIT_THRESHOLD 
+ *        이상이면 내부 페이지 중 [lo, hi) 에 든 것만 반납. 이미 반납된 큰
+ *        이웃을 합칠 때마다 그 페이지를 다시 반납하지 않도록 mm_free 가
+ *        새로 프리된 범위를 넘겨준다
+ */
+static void trim(void *bp, char *lo, char *hi)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *start = (char *)bp + DSIZE;
+    char *end = (char *)bp + size - DSIZE;
+
+    if (GET_SIZE(HDRP(NEXT_BLKP(bp))) != 0) {
+        /* 헤더, 리스트 포인터, 푸터가 있는 페이지는 남김 */
+        if (size >= DECOMMIT_THRESHOLD) {
+            start = (lo > start) ? lo : start;
+            end = (hi < end) ? hi : end;
+            if (start < end) {
+                mem_decommit(start, end - start);
+            }
+        }
+        return;
+    }
+    if (size < TRIM_THRESHOLD) {
+        return;
+    }
+
+    escape(bp);
+    set_free(bp, CHUNKSIZE);
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
+    mem_sbrk(-(int)(size - CHUNKSIZE));
+    insert(bp);
+}
+
 /* 
  * place - Place block of asize bytes at start of free block bp 
  *         and split if remainder would be at least minimum block size
@@ -427,25 +724,20 @@ static void place(void *bp, size_t asize)
     size_t csize = GET_SIZE(HDRP(bp));   
     size_t remainder = csize - asize;
 
-    if (remainder <= DDSIZE) {
-        PUT(HDRP(bp), PACK(csize, 1));
-        PUT(FTRP(bp), PACK(csize, 1));
+    if (remainder < DDSIZE) {
+        set_alloc(bp, csize);
     }
     /* 사이즈가 24 워드보다 큰 경우 뒤에 배치 */
     else if (asize >= ((WSIZE<<4)|(WSIZE<<2))) {
-        PUT(HDRP(bp), PACK(remainder, 0));
-        PUT(FTRP(bp), PACK(remainder, 0));
-        PUT(HDRP(NEXT_BLKP(bp)), PACK(asize, 1));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(asize, 1));
+        set_free(bp, remainder);
+        set_alloc(NEXT_BLKP(bp), asize);
         /* 남은 공간 프리리스트에 삽입 */
         insert(bp);
     }
     /* 앞에 배치 */
     else {
-        PUT(HDRP(bp), PACK(asize, 1));
-        PUT(FTRP(bp), PACK(asize, 1));
-        PUT(HDRP(NEXT_BLKP(bp)), PACK(remainder, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(remainder, 0));
+        set_alloc(bp, asize);
+        set_free(NEXT_BLKP(bp), remainder);
         insert(NEXT_BLKP(bp));
     }
 }
@@ -474,17 +766,26 @@ static void *find_fit(size_t asize)
 #else 
     /* first fit search */
     size_t rank = getRank(asize);
+    size_t bitmap;
     void *bp;
 
-    /* 크기를 기준으로 삽입되었을 프리리스트 헤더 포인터 받은 후, 계층을 올려가며 탐색 */
-    while (rank < RANKSIZE) {
-        for (bp = GET_RANK(rank); bp != NULL; bp = GET_NEXT(bp)) {
-            if (asize <= GET_SIZE(HDRP(bp))) {
-                return bp;
-            }
+    /* 마지막 계층은 트리에서 최적 적합 블록을 찾음 */
+    if (rank == RANKSIZE - 1) {
+        return tree_fit(asize);
+    }
+
+    /* 같은 계층에는 asize 보다 작은 블록이 있을 수 있으므로 리스트를 탐색 */
+    for (bp = GET_RANK(rank); bp != NULL; bp = GET_NEXT(bp)) {
+        if (asize <= GET_SIZE(HDRP(bp))) {
+            return bp;
         }
+    }
 
-        ++rank; // 계층 올리기
+    /* 상위 계층의 블록은 모두 asize 보다 크므로, 비트맵에서 비어있지 않은 가장 낮은 계층의 첫 블록을 반환 */
+    bitmap = GET_BITMAP() & ~(((size_t)2 << rank) - 1);
+    if (bitmap != 0) {
+        rank = FFS(bitmap);
+        return rank == RANKSIZE - 1 ? tree_fit(asize) : GET_RANK(rank);
     }
 
     return NULL; /* no fit */
@@ -496,7 +797,7 @@ static void *find_fit(size_t asize)
  */
 static void *coalesce(void *bp) 
 {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+    size_t prev_alloc = PREV_ALLOC(bp);
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     size_t size = GET_SIZE(HDRP(bp));
 
@@ -506,26 +807,23 @@ static void *coalesce(void *bp)
     else if (prev_alloc && !next_alloc) {      /* Case 2 */
     escape(NEXT_BLKP(bp));
 	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-	PUT(HDRP(bp), PACK(size, 0));
-	PUT(FTRP(bp), PACK(size,0));
+	set_free(bp, size);
     }
 
     else if (!prev_alloc && next_alloc) {      /* Case 3 */
     escape(PREV_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-	PUT(FTRP(bp), PACK(size, 0));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
 	bp = PREV_BLKP(bp);
+	set_free(bp, size);
     }
 
     else {                                     /* Case 4 */
     escape(NEXT_BLKP(bp));
     escape(PREV_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
-	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+	    GET_SIZE(HDRP(NEXT_BLKP(bp)));
 	bp = PREV_BLKP(bp);
+	set_free(bp, size);
     }
 
 #ifdef NEXT_FIT
@@ -555,59 +853,464 @@ static void printblock(void *bp)
     }
 
     printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp, 
-	   hsize, (halloc ? 'a' : 'f'), 
-	   fsize, (falloc ? 'a' : 'f')); 
+	   (int)hsize, (halloc ? 'a' : 'f'), 
+	   (int)fsize, (falloc ? 'a' : 'f')); 
 }
 
 static void checkblock(void *bp) 
 {
-    if ((size_t)bp % 8)
-	printf("Error: %p is not doubleword aligned\n", bp);
+    if ((size_t)bp % ALIGNMENT)
+	printf("Error: %p is not %d-byte aligned\n", bp, ALIGNMENT);
+#ifdef NO_FOOTER
+    /* 푸터는 프리 블록에만 있음 */
+    if (!GET_ALLOC(HDRP(bp)) && 
+        (GET_SIZE(HDRP(bp)) != GET_SIZE(FTRP(bp)) || GET_ALLOC(FTRP(bp))))
+#else
     if (GET(HDRP(bp)) != GET(FTRP(bp)))
+#endif
 	printf("Error: header does not match footer\n");
 }
 
+/*
+ * set_alloc - bp 를 size 바이트 할당 블록으로 기록. 
+ *             푸터가 없으면 헤더의 이전 블록 할당 비트를 유지하고 다음 블록 헤더에 표시
+ */
+static void set_alloc(void *bp, size_t size)
+{
+#ifdef NO_FOOTER
+    PUT(HDRP(bp), PACK(size, GET_PALLOC(HDRP(bp)) | 1));
+    PUT(HDRP(NEXT_BLKP(bp)), GET(HDRP(NEXT_BLKP(bp))) | PALLOC);
+#else
+    PUT(HDRP(bp), PACK(size, 1));
+    PUT(FTRP(bp), PACK(size, 1));
+#endif
+}
+
+/*
+ * set_free - bp 를 size 바이트 프리 블록으로 기록. 
+ *            푸터가 없으면 헤더의 이전 블록 할당 비트를 유지하고 다음 블록 헤더에서 지움
+ */
+static void set_free(void *bp, size_t size)
+{
+#ifdef NO_FOOTER
+    PUT(HDRP(bp), PACK(size, GET_PALLOC(HDRP(bp))));
+    PUT(FTRP(bp), PACK(size, 0));
+    PUT(HDRP(NEXT_BLKP(bp)), GET(HDRP(NEXT_BLKP(bp))) & ~PALLOC);
+#else
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+#endif
+}
+
 /* Private Functions */
 /* 사이즈에 맞는 계층 번호를 반환하는 함수 */
-size_t getRank(size_t size) {
-    if (size <= RANK0) return 0;
-    if (size <= RANK1) return 1;
-    if (size <= RANK2) return 2;
-    if (size <= RANK3) return 3;
-    if (size <= RANK4) return 4;
-    if (size <= RANK5) return 5;
-    if (size <= RANK6) return 6;
-    if (size <= RANK7) return 7;
-    if (size <= RANK8) return 8;
-    return 9;
+static size_t getRank(size_t size) {
+    size_t rank;
+
+    /* Rank 0 ~ 3 은 RANK0 간격 */
+    if (size <= RANK3) return (size - 1) / RANK0;
+
+    /* 이후 계층은 올림한 log2 값으로 계산 */
+    rank = LOG2(size - 1) + 1 - RANKSHIFT;
+    return MIN(rank, RANKSIZE - 1);
 }
 
 /* FIFO */
 /* 프리리스트에 프리 블록을 삽입 시키는 함수 */
-void insert(void *bp) {
+static void insert(void *bp) {
     size_t rank = getRank(GET_SIZE(HDRP(bp)));
 
-    GET_NEXT(bp) = GET_RANK(rank);
+    if (rank == RANKSIZE - 1) {
+        tree_insert(bp);
+        return;
+    }
+
+    SET_NEXT(bp, GET_RANK(rank));
     /* NULL이 아니면, 첫 번째 프리 블록의 이전 노드로 현재 노드를 지정해줘야 함 */
     if (GET_RANK(rank) != NULL) {
-        GET_PREV(GET_RANK(rank)) = bp;
+        SET_PREV(GET_RANK(rank), bp);
     }
     GET_RANK(rank) = bp;
+    GET_BITMAP() |= (size_t)1 << rank;
 }
 
 /* 프리리스트에서 프리 블록을 제외 시키는 함수 */
-void escape(void *bp) {
+static void escape(void *bp) {
     size_t rank = getRank(GET_SIZE(HDRP(bp)));
 
+    if (rank == RANKSIZE - 1) {
+        tree_remove(bp);
+        return;
+    }
+
     /* 프리 리스트 헤더가 가리키는 첫 번째 노드가 현재 노드인 경우 */
     if (bp == GET_RANK(rank)) {
         GET_RANK(rank) = GET_NEXT(GET_RANK(rank));
+        /* 리스트가 비었으면 비트맵에서 해당 계층 비트를 지움 */
+        if (GET_RANK(rank) == NULL) {
+            GET_BITMAP() &= ~((size_t)1 << rank);
+        }
         return;
     }
 
     /* 이전 노드와 다음 노드를 연결해줌 */
-    GET_NEXT(GET_PREV(bp)) = GET_NEXT(bp);
+    SET_NEXT(GET_PREV(bp), GET_NEXT(bp));
     if (GET_NEXT(bp) != NULL) {
-        GET_PREV(GET_NEXT(bp)) = GET_PREV(bp);
+        SET_PREV(GET_NEXT(bp), GET_PREV(bp));
+    }
+}
+/*
+ * map_alloc - size 바이트 요청을 힙 밖에 따로 매핑한 블록에 할당
+ */
+static void *map_alloc(size_t size)
+{
+    size_t len = ALIGN_UP(size + MAP_HDR);  /* 길이 워드와 헤더 포함 */
+    char *p;
+
+    /* 힙 한도보다 큰 요청은 len 계산이 넘칠 수 있으므로 바로 실패 */
+    if (size > MAX_HEAP_LIMIT || (p = mem_map(len)) == NULL) {
+        return NULL;
+    }
+    PUT(p + MAP_HDR - DSIZE, len);
+    PUT(p + MAP_HDR - WSIZE, MAP_TAG);
+    return p + MAP_HDR;
+}
+
+/*
+ * map_realloc - 매핑된 블록의 크기를 바꾼다. 계속 큰 블록이면 mem_remap 으로 바이트 대신
+ *               페이지 테이블을 옮기고, 작아지면 힙에 새로 할당해서 복사한 뒤 매핑을 반납
+ */
+static void *map_realloc(void *ptr, size_t size)
+{
+    size_t len = ALIGN_UP(size + MAP_HDR);
+    char *p;
+    void *new_ptr;
+
+    if (size >= MMAP_THRESHOLD) {
+        if ((p = mem_remap((char *)ptr - MAP_HDR, len)) == NULL) {
+            return NULL;
+        }
+        PUT(p + MAP_HDR - DSIZE, len);
+        return p + MAP_HDR;
+    }
+    if ((new_ptr = mm_malloc(size)) == NULL) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, size);
+    mem_unmap((char *)ptr - MAP_HDR);
+    return new_ptr;
+}
+
+/*
+ * slab_alloc - cls 계층의 런에서 빈 객체 하나를 할당
+ */
+static void *slab_alloc(size_t cls)
+{
+    char *r = GET_SLAB(cls);
+    size_t i, w;
+
+    if (r == NULL && (r = new_run(cls)) == NULL) {
+        return NULL;
+    }
+
+    /* 비트맵에서 첫 번째 빈 객체를 찾음 */
+    for (w = 0; RUN_MAP(r)[w] == 0; ++w)
+        ;
+    i = FFS(RUN_MAP(r)[w]);
+    RUN_MAP(r)[w] &= ~((size_t)1 << i);
+
+    /* 런이 가득 차면 리스트에서 제외 */
+    if (++RUN_USED(r) == RUN_CAP(r)) {
+        GET_SLAB(cls) = RUN_NEXT(r);
+        if (RUN_NEXT(r) != NULL) {
+            RUN_PREV(RUN_NEXT(r)) = NULL;
+        }
+    }
+
+    return r + RUN_HDRSIZE(RUN_CAP(r)) + (w * MAP_BITS + i) * SLAB_OBJSIZE(cls);
+}
+
+/*
+ * slab_free - 슬랩 객체를 해제. 런이 비고 같은 계층에 다른 런이 있으면 런을 힙에 반환
+ */
+static void slab_free(void *p)
+{
+    char *r = RUN_OF(p);
+    size_t cls = RUN_CLASS(r);
+    size_t i = ((char *)p - r - RUN_HDRSIZE(RUN_CAP(r))) / SLAB_OBJSIZE(cls);
+
+    RUN_MAP(r)[i / MAP_BITS] |= (size_t)1 << (i % MAP_BITS);
+
+    /* 가득 차 있던 런이면 다시 리스트에 삽입 */
+    if (RUN_USED(r)-- == RUN_CAP(r)) {
+        RUN_PREV(r) = NULL;
+        RUN_NEXT(r) = GET_SLAB(cls);
+        if (GET_SLAB(cls) != NULL) {
+            RUN_PREV(GET_SLAB(cls)) = r;
+        }
+        GET_SLAB(cls) = r;
+    }
+
+    if (RUN_USED(r) > 0 || (GET_SLAB(cls) == r && RUN_NEXT(r) == NULL)) {
+        return;
+    }
+
+    /* 빈 런을 리스트에서 제외하고 일반 블록으로 해제 */
+    if (RUN_PREV(r) != NULL) {
+        RUN_NEXT(RUN_PREV(r)) = RUN_NEXT(r);
+    } else {
+        GET_SLAB(cls) = RUN_NEXT(r);
+    }
+    if (RUN_NEXT(r) != NULL) {
+        RUN_PREV(RUN_NEXT(r)) = RUN_PREV(r);
+    }
+    slab_map[PAGE_IDX(r) / MAP_BITS] &= ~((size_t)1 << (PAGE_IDX(r) % MAP_BITS));
+    mm_free(r);
+}
+
+/*
+ * new_run - RUN_SIZE 로 정렬된 런을 만들어 cls 계층 리스트에 삽입.
+ *           프리 블록 중 정렬된 런이 들어갈 자리가 있으면 사용하고, 없으면 힙을 늘린다.
+ */
+static void *new_run(size_t cls)
+{
+    size_t rank, size, objsize = SLAB_OBJSIZE(cls), cap, i;
+    char *bp, *r = NULL, *end, *tail;
+
+    /* RUN_SIZE 이상인 계층의 프리 블록에서 정렬된 자리를 찾음 */
+    for (rank = getRank(RUN_SIZE); r == NULL && rank < RANKSIZE - 1; ++rank) {
+        for (bp = GET_RANK(rank); bp != NULL; bp = GET_NEXT(bp)) {
+            if ((r = run_fit(bp, GET_SIZE(HDRP(bp)))) != NULL) {
+                break;
+            }
+        }
+    }
+    /* 트리에서는 런 두 개 크기 이상인 가장 작은 블록을 시도 */
+    if (r == NULL && (bp = tree_fit(RUN_SIZE<<1)) != NULL) {
+        r = run_fit(bp, GET_SIZE(HDRP(bp)));
+    }
+
+    /* 없으면 마지막 블록(프리라면 그 블록부터)에 이어 정렬된 자리까지 힙을 늘림 */
+    if (r == NULL) {
+        end = (char *)mem_heap_hi() + 1;
+        tail = PREV_ALLOC(end) ? end : end - GET_SIZE(end - DSIZE);
+        r = RUN_OF(tail + RUN_SIZE - 1);
+        if (r > tail && r - tail < DDSIZE) {
+            r += RUN_SIZE;
+        }
+        if ((bp = extend_heap((r + RUN_SIZE - end) / WSIZE)) == NULL) {
+            return NULL;
+        }
+        r = run_fit(bp, GET_SIZE(HDRP(bp)));
+    }
+
+    /* 프리 블록을 [앞 프리 블록][런][뒤 프리 블록] 으로 분할 */
+    escape(bp);
+    end = bp + GET_SIZE(HDRP(bp));
+    if (r > bp) {
+        set_free(bp, r - bp);
+        insert(bp);
+    }
+    set_alloc(r, RUN_SIZE);
+    if (end > r + RUN_SIZE) {
+        bp = r + RUN_SIZE;
+        set_free(bp, end - bp);
+        insert(bp);
+    }
+
+    /* 헤더와 비트맵을 제외하고 들어갈 수 있는 객체 수 */
+    size = RUN_SIZE - OVERHEAD;
+    for (cap = (size - 5*PSIZE) / objsize; RUN_HDRSIZE(cap) + cap * objsize > size; --cap)
+        ;
+
+    RUN_CLASS(r) = cls;
+    RUN_USED(r) = 0;
+    RUN_CAP(r) = cap;
+    for (i = 0; i < MAP_WORDS(cap); ++i) {
+        RUN_MAP(r)[i] = (cap - i * MAP_BITS >= MAP_BITS) ? ~(size_t)0 : ((size_t)1 << (cap - i * MAP_BITS)) - 1;
+    }
+    RUN_PREV(r) = NULL;
+    RUN_NEXT(r) = GET_SLAB(cls);
+    if (GET_SLAB(cls) != NULL) {
+        RUN_PREV(GET_SLAB(cls)) = r;
+    }
+    GET_SLAB(cls) = r;
+    slab_map[PAGE_IDX(r) / MAP_BITS] |= (size_t)1 << (PAGE_IDX(r) % MAP_BITS);
+
+    return r;
+}
+
+/*
+ * run_fit - 프리 블록 bp 안에 정렬된 런이 들어갈 수 있으면 런 주소를, 아니면 NULL 반환.
+ *           앞뒤로 남는 공간은 없거나 최소 블록 크기 이상이어야 한다.
+ */
+static char *run_fit(char *bp, size_t size)
+{
+    char *r = RUN_OF(bp + RUN_SIZE - 1);
+
+    if (r > bp && r - bp < DDSIZE) {
+        r += RUN_SIZE;
+    }
+    if (r + RUN_SIZE > bp + size ||
+        ((bp + size) > (r + RUN_SIZE) && (bp + size) - (r + RUN_SIZE) < DDSIZE)) {
+        return NULL;
+    }
+    return r;
+}
+
+/*
+ * tree_cmp - (size, addr) 키와 트리 노드 bp 의 키를 비교. 크기가 같으면 주소로 비교
+ */
+static int tree_cmp(size_t size, char *addr, void *bp)
+{
+    size_t bsize = GET_SIZE(HDRP(bp));
+
+    if (size != bsize) {
+        return size < bsize ? -1 : 1;
+    }
+    if (addr != (char *)bp) {
+        return addr < (char *)bp ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * splay - top-down splay. 루트가 t 인 트리에서 (size, addr) 키와 같은 노드,
+ *         없으면 그 바로 앞이나 뒤의 노드를 루트로 올리고 새 루트를 반환
+ */
+static void *splay(void *t, size_t size, char *addr)
+{
+    /* 왼쪽, 오른쪽 트리의 루트와 마지막 노드. 링크가 힙 오프셋이므로 스택의 임시 노드 대신 사용 */
+    void *lroot = NULL, *rroot = NULL, *l = NULL, *r = NULL, *y;
+    int c;
+
+    while ((c = tree_cmp(size, addr, t)) != 0) {
+        if (c < 0) {
+            if (GET_LEFT(t) == NULL) break;
+            /* zig-zig 이면 오른쪽으로 회전 */
+            if (tree_cmp(size, addr, GET_LEFT(t)) < 0) {
+                y = GET_LEFT(t);
+                SET_LEFT(t, GET_RIGHT(y));
+                SET_RIGHT(y, t);
+                t = y;
+                if (GET_LEFT(t) == NULL) break;
+            }
+            /* 오른쪽 트리에 연결 */
+            if (r == NULL) rroot = t; else SET_LEFT(r, t);
+            r = t;
+            t = GET_LEFT(t);
+        } else {
+            if (GET_RIGHT(t) == NULL) break;
+            /* zag-zag 이면 왼쪽으로 회전 */
+            if (tree_cmp(size, addr, GET_RIGHT(t)) > 0) {
+                y = GET_RIGHT(t);
+                SET_RIGHT(t, GET_LEFT(y));
+                SET_LEFT(y, t);
+                t = y;
+                if (GET_RIGHT(t) == NULL) break;
+            }
+            /* 왼쪽 트리에 연결 */
+            if (l == NULL) lroot = t; else SET_RIGHT(l, t);
+            l = t;
+            t = GET_RIGHT(t);
+        }
+    }
+
+    /* 왼쪽 트리, 오른쪽 트리와 t 를 합침 */
+    if (l == NULL) lroot = GET_LEFT(t); else SET_RIGHT(l, GET_LEFT(t));
+    if (r == NULL) rroot = GET_RIGHT(t); else SET_LEFT(r, GET_RIGHT(t));
+    SET_LEFT(t, lroot);
+    SET_RIGHT(t, rroot);
+    return t;
+}
+
+/* 트리에 프리 블록을 삽입 */
+static void tree_insert(void *bp)
+{
+    void *root = GET_RANK(RANKSIZE - 1);
+
+    SET_LEFT(bp, NULL);
+    SET_RIGHT(bp, NULL);
+    if (root != NULL) {
+        root = splay(root, GET_SIZE(HDRP(bp)), bp);
+        /* 루트를 기준으로 둘로 나누어 bp 의 양쪽 자식으로 붙임 */
+        if (tree_cmp(GET_SIZE(HDRP(bp)), bp, root) < 0) {
+            SET_LEFT(bp, GET_LEFT(root));
+            SET_RIGHT(bp, root);
+            SET_LEFT(root, NULL);
+        } else {
+            SET_RIGHT(bp, GET_RIGHT(root));
+            SET_LEFT(bp, root);
+            SET_RIGHT(root, NULL);
+        }
+    }
+    GET_RANK(RANKSIZE - 1) = bp;
+    GET_BITMAP() |= (size_t)1 << (RANKSIZE - 1);
+}
+
+/* 트리에서 프리 블록을 제거 */
+static void tree_remove(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    void *root = splay(GET_RANK(RANKSIZE - 1), size, bp);
+
+    /* bp 가 루트. 왼쪽 서브트리의 가장 큰 노드를 올려 오른쪽 서브트리를 붙임 */
+    if (GET_LEFT(root) == NULL) {
+        root = GET_RIGHT(bp);
+    } else {
+        root = splay(GET_LEFT(bp), size, bp);
+        SET_RIGHT(root, GET_RIGHT(bp));
+    }
+    GET_RANK(RANKSIZE - 1) = root;
+    if (root == NULL) {
+        GET_BITMAP() &= ~((size_t)1 << (RANKSIZE - 1));
+    }
+}
+
+/* 트리에서 asize 이상인 가장 작은 블록 (같으면 가장 낮은 주소) 을 반환 */
+static void *tree_fit(size_t asize)
+{
+    void *bp = GET_RANK(RANKSIZE - 1);
+
+    if (bp == NULL) {
+        return NULL;
     }
-}
\ No newline at end of file
+    GET_RANK(RANKSIZE - 1) = bp = splay(bp, asize, NULL);
+    if (GET_SIZE(HDRP(bp)) >= asize) {
+        return bp;
+    }
+
+    /* 루트가 바로 앞의 노드이면 오른쪽 서브트리의 가장 작은 노드 */
+    if ((bp = GET_RIGHT(bp)) != NULL) {
+        while (GET_LEFT(bp) != NULL) {
+            bp = GET_LEFT(bp);
+        }
+    }
+    return bp;
+}
+
+/* 트리의 모든 블록의 표시 비트를 뒤집음 */
+static void tree_toggle(void *bp)
+{
+    if (bp == NULL) {
+        return;
+    }
+    PUT(HDRP(bp), GET(HDRP(bp)) ^ 4);
+    tree_toggle(GET_LEFT(bp));
+    tree_toggle(GET_RIGHT(bp));
+}
+
+/* 트리의 노드가 lo 와 hi 사이의 키를 가지고 마지막 계층 크기인지 테스트 */
+static void tree_check(void *bp, void *lo, void *hi)
+{
+    if (bp == NULL) {
+        return;
+    }
+    if (GET_ALLOC(HDRP(bp)) || getRank(GET_SIZE(HDRP(bp))) != RANKSIZE - 1)
+        printf("Error: bad tree node %p\n", bp);
+    if ((lo != NULL && tree_cmp(GET_SIZE(HDRP(lo)), lo, bp) >= 0) ||
+        (hi != NULL && tree_cmp(GET_SIZE(HDRP(hi)), hi, bp) <= 0))
+        printf("Error: tree node %p is out of order\n", bp);
+    tree_check(GET_LEFT(bp), lo, bp);
+    tree_check(GET_RIGHT(bp), bp, hi);
+}
@@ -0,0 +1,583 @@
+/*
+ * mm-tlsf.c -  Two-level segregated fit (TLSF) allocator with
+ *              boundary tag coalescing and bounded O(1) malloc/free.
+ *
+ * Each block has header and footer of the form:
+ *
+ *      31                     3  2  1  0
+ *      -----------------------------------
+ *     | s  s  s  s  ... s  s  s  0  0  a/f
+ *      -----------------------------------
+ *
+ * where s are the meaningful size bits and a/f is set
+ * iff the block is allocated. Free blocks keep prev/next pointers
+ * in the first two payload words. The list has the following form:
+ *
+ * begin                                                                  end
+ * heap                                                                   heap
+ *  -------------------------------------------------------------------------
+ * |  pad   | hdr(a) | control | ftr(a) | zero or more usr blks | hdr(0:a) |
+ *  -------------------------------------------------------------------------
+ *          |       prologue block     |                       | epilogue |
+ *
+ * The prologue payload holds the TLSF control structure:
+ *
+ *   fl_bitmap                    - bit f set iff sl_bitmap[f] != 0
+ *   sl_bitmap[FL_COUNT]          - bit s set iff list (f, s) is not empty
+ *   heads[FL_COUNT][SL_COUNT]    - free list heads
+ *
+ * A size is mapped to a first level index f (its power of two range) and
+ * a second level index s (one of SL_COUNT linear slices of that range).
+ * malloc rounds the request up to the next slice, so that any block in
+ * the selected list fits, and finds the list with two bit scans. Both
+ * malloc and free therefore run in constant time regardless of the
+ * number of free blocks.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+/* Team structure (this should be one-man team, meaning that you are the only member of the team) */
+team_t team = {
+    "tlsf good fit",
+    "오치현", "2021029889", /* your name and student id in quote */
+    "", ""
+};
+
+/* $begin mallocmacros */
+/* Basic constants and macros */
+#define WSIZE       (ALIGNMENT/2) /* word size (bytes), 8 in 64-bit builds */
+#define DSIZE       ALIGNMENT     /* doubleword size (bytes) */
+#define DDSIZE      (2*ALIGNMENT) /* doubledoubleword size (bytes) */
+#define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
+#define OVERHEAD    (2*WSIZE)     /* overhead of header and footer (bytes) */
+
+/* TLSF index parameters */
+#define SL_LOG2       3                           /* log2 of second level slices */
+#define SL_COUNT      (1 << SL_LOG2)              /* second level lists per first level */
+#define FL_SHIFT      (SL_LOG2 + LOG2(DSIZE))     /* sizes below 1<<FL_SHIFT share first level 0 */
+#define SMALL_BLOCK   (1 << FL_SHIFT)
+#define FL_INDEX_MAX  30                          /* largest block is below 1<<(FL_INDEX_MAX+1) */
+#define FL_COUNT      (FL_INDEX_MAX - FL_SHIFT + 2)
+
+/* Words of control structure in the prologue payload, rounded to a doubleword */
+#define CTRL_WORDS    (1 + FL_COUNT + FL_COUNT * SL_COUNT)
+#define PROLOGUE_SIZE (((CTRL_WORDS + 1) & ~1) * WSIZE + DSIZE)
+
+#define MAX(x, y) ((x) > (y)? (x) : (y))
+#define MIN(x, y) ((x) < (y)? (x) : (y))
+
+/* Pack a size and allocated bit into a word */
+#define PACK(size, alloc)  ((size) | (alloc))
+
+/* Read and write a word at address p */
+#define GET(p)       (*(size_t *)(p))
+#define PUT(p, val)  (*(size_t *)(p) = (val))
+
+/* Read the size and allocated fields from address p */
+#define GET_SIZE(p)  (GET(p) & ~0x7)
+#define GET_ALLOC(p) (GET(p) & 0x1)
+
+/* Given block ptr bp, compute address of its header and footer */
+#define HDRP(bp)       ((char *)(bp) - WSIZE)
+#define FTRP(bp)       ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
+
+/* Given block ptr bp, compute address of next and previous blocks */
+#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
+#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
+
+/* 프리리스트에 연결된 노드의 다음 또는 이전 프리 블록 포인터 반환 */
+#define GET_NEXT(bp)    (*(void**)((char *)(bp) + WSIZE))
+#define GET_PREV(bp)    (*(void**)(bp))
+
+/* 프롤로그 안의 TLSF 제어 구조 */
+#define FL_BITMAP()       (*(size_t *)(heap_listp))
+#define SL_BITMAP(fl)     (*(size_t *)((char *)(heap_listp) + WSIZE*(1 + (fl))))
+#define GET_HEAD(fl, sl)  (*(void**)((char *)(heap_listp) + WSIZE*(1 + FL_COUNT + (fl)*SL_COUNT + (sl))))
+
+/* 2를 밑으로 하는 로그 (내림), 가장 낮은 1 비트의 위치 */
+#define LOG2(x)         ((sizeof(unsigned long)<<3) - 1 - __builtin_clzl((unsigned long)(x)))
+#define FFS(x)          ((size_t)__builtin_ctzl((unsigned long)(x)))
+
+/* 2 워드 사이즈 단위로 올림 */
+#define ALIGN(size)     (DSIZE * ((size + DDSIZE - 1) / DSIZE))
+/* $end mallocmacros */
+
+/* Global variables */
+static char *heap_listp;  /* pointer to the control structure in the prologue */
+
+/* function prototypes for internal helper routines */
+static void *extend_heap(size_t words);
+static void place(void *bp, size_t asize);
+static void *find_fit(size_t asize);
+static void *coalesce(void *bp);
+static void trim(void *bp, char *lo, char *hi);
+static void printblock(void *bp);
+static void checkblock(void *bp);
+
+static void mapping_insert(size_t size, size_t *fl, size_t *sl);
+static void mapping_search(size_t size, size_t *fl, size_t *sl);
+static void insert(void *bp);
+static void escape(void *bp);
+
+/*
+ * mm_init - Initialize the memory manager
+ */
+/* $begin mminit */
+int mm_init(void)
+{
+    char *p;
+
+    /* create the initial empty heap */
+    if ((p = mem_sbrk(PROLOGUE_SIZE + DSIZE)) == (void *)-1)
+	return -1;
+    PUT(p, 0);                                       /* alignment padding */
+    PUT(p+WSIZE, PACK(PROLOGUE_SIZE, 1));            /* prologue header */
+    memset(p+DSIZE, 0, PROLOGUE_SIZE - DSIZE);       /* 비트맵과 프리 리스트 헤더 초기화 */
+    PUT(p+PROLOGUE_SIZE, PACK(PROLOGUE_SIZE, 1));    /* prologue footer */
+    PUT(p+PROLOGUE_SIZE+WSIZE, PACK(0, 1));          /* epilogue header */
+    heap_listp = p + DSIZE;
+
+    /* Extend the empty heap with a free block of CHUNKSIZE bytes */
+    if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
+	return -1;
+    return 0;
+}
+/* $end mminit */
+
+/*
+ * mm_malloc - Allocate a block with at least size bytes of payload
+ */
+/* $begin mmmalloc */
+void *mm_malloc(size_t size)
+{
+    size_t asize;
+    size_t extendsize;
+    void *bp;
+
+    if (size == 0)
+	return NULL;
+
+    if (size <= DSIZE) { // 최소 할당 사이즈는 4 워드
+        asize = DDSIZE;
+    } else {
+        asize = ALIGN(size);
+    }
+
+    if ((bp = find_fit(asize)) == NULL) {
+        extendsize = MAX(asize, CHUNKSIZE); // 청크 사이즈와 요구 사이즈 중 큰 것
+        if ((bp = extend_heap(extendsize / WSIZE)) == NULL)
+            return NULL;
+    }
+
+    place(bp, asize);
+    return bp;
+}
+/* $end mmmalloc */
+
+/*
+ * mm_free - Free a block
+ */
+/* $begin mmfree */
+void mm_free(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *lo = bp, *hi;
+
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+
+    /* 아직 반납되지 않은 범위는 이 블록과 DECOMMIT_THRESHOLD 보다 작은 프리
+       이웃. 그보다 큰 이웃은 이미 반납되어 맞닿은 페이지만 남아 있다 */
+    hi = NEXT_BLKP(bp);
+    if (!GET_ALLOC(FTRP(PREV_BLKP(bp)))) {
+        lo = (GET_SIZE(HDRP(PREV_BLKP(bp))) < DECOMMIT_THRESHOLD) ?
+            PREV_BLKP(bp) : lo - mem_pagesize();
+    }
+    if (!GET_ALLOC(HDRP(hi))) {
+        hi += (GET_SIZE(HDRP(hi)) < DECOMMIT_THRESHOLD) ?
+            GET_SIZE(HDRP(hi)) : mem_pagesize();
+    }
+    trim(coalesce(bp), lo, hi);
+}
+/* $end mmfree */
+
+/*
+ * mm_realloc - shrink or grow in place when the next block allows it,
+ *              otherwise fall back to malloc, copy and free
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+    size_t asize, csize, next_size;
+    void *new_ptr;
+
+    // 포인터가 널이면, malloc 과 같은 동작을 한다.
+    if (ptr == NULL) {
+        return mm_malloc(size);
+    }
+
+    // 사이즈가 0이면 free 와 같은 동작을 한다.
+    if (size == 0) {
+        mm_free(ptr);
+        return NULL;
+    }
+
+    if (size <= DSIZE) {
+        asize = DDSIZE;
+    } else {
+        asize = ALIGN(size);
+    }
+    csize = GET_SIZE(HDRP(ptr));
+
+    /* 다음 블록이 프리 블록이면 합쳐서 제자리에서 늘릴 수 있는지 확인 */
+    if (asize > csize && !GET_ALLOC(HDRP(NEXT_BLKP(ptr)))) {
+        next_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
+        if (csize + next_size >= asize) {
+            escape(NEXT_BLKP(ptr));
+            csize += next_size;
+            PUT(HDRP(ptr), PACK(csize, 1));
+            PUT(FTRP(ptr), PACK(csize, 1));
+        }
+    }
+
+    /* 현재 블록 안에서 처리 가능하면 남는 공간만 잘라서 반환 */
+    if (asize <= csize) {
+        if (csize - asize >= DDSIZE) {
+            PUT(HDRP(ptr), PACK(asize, 1));
+            PUT(FTRP(ptr), PACK(asize, 1));
+            PUT(HDRP(NEXT_BLKP(ptr)), PACK(csize - asize, 0));
+            PUT(FTRP(NEXT_BLKP(ptr)), PACK(csize - asize, 0));
+            coalesce(NEXT_BLKP(ptr));
+        }
+        return ptr;
+    }
+
+    if ((new_ptr = mm_malloc(size)) == NULL) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, csize - DSIZE);
+    mm_free(ptr);
+
+    return new_ptr;
+}
+
+/*
+ * mm_usable_size - 할당된 블록에서 실제로 쓸 수 있는 바이트 수를 반환한다.
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if (ptr == NULL) {
+        return 0;
+    }
+    return GET_SIZE(HDRP(ptr)) - OVERHEAD;
+}
+
+/*
+ * mm_checkheap - Check the heap for consistency
+ */
+void mm_checkheap(int verbose)
+{
+    char *bp;
+    size_t fl, sl, heap_free = 0, list_free = 0;
+
+    if (verbose)
+	printf("Heap (%p):\n", heap_listp);
+
+    if ((GET_SIZE(HDRP(heap_listp)) != PROLOGUE_SIZE) || !GET_ALLOC(HDRP(heap_listp)))
+	printf("Bad prologue header\n");
+    checkblock(heap_listp);
+
+    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+	if (verbose)
+	    printblock(bp);
+	checkblock(bp);
+        if (!GET_ALLOC(HDRP(bp))) {
+            heap_free++;
+            if (!GET_ALLOC(HDRP(NEXT_BLKP(bp))))
+                printf("Error: %p is not coalesced with the next block\n", bp);
+        }
+    }
+
+    if (verbose)
+	printblock(bp);
+    if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
+	printf("Bad epilogue header\n");
+
+    /* 비트맵과 프리 리스트가 일치하는지, 블록이 올바른 리스트에 있는지 테스트 */
+    for (fl = 0; fl < FL_COUNT; fl++) {
+        if (((FL_BITMAP() >> fl) & 1) != (SL_BITMAP(fl) != 0))
+            printf("Error: first level bitmap mismatch at %d\n", (int)fl);
+        for (sl = 0; sl < SL_COUNT; sl++) {
+            if (((SL_BITMAP(fl) >> sl) & 1) != (GET_HEAD(fl, sl) != NULL))
+                printf("Error: second level bitmap mismatch at (%d, %d)\n", (int)fl, (int)sl);
+            for (bp = GET_HEAD(fl, sl); bp != NULL; bp = GET_NEXT(bp)) {
+                size_t f, s;
+                list_free++;
+                mapping_insert(GET_SIZE(HDRP(bp)), &f, &s);
+                if (GET_ALLOC(HDRP(bp)) || f != fl || s != sl)
+                    printf("Error: %p is in the wrong free list (%d, %d)\n", bp, (int)fl, (int)sl);
+            }
+        }
+    }
+    if (heap_free != list_free)
+        printf("Error: %d free blocks in heap, %d in free lists\n", (int)heap_free, (int)list_free);
+}
+
+/* The remaining routines are internal helper routines */
+
+/*
+ * extend_heap - Extend heap with free block and return its block pointer
+ */
+/* $begin mmextendheap */
+static void *extend_heap(size_t words)
+{
+    char *bp;
+    size_t size;
+
+    /* Allocate an even number of words to maintain alignment */
+    size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
+    if ((bp = mem_sbrk(size)) == (void *)-1)
+	return NULL;
+
+    /* Initialize free block header/footer and the epilogue header */
+    PUT(HDRP(bp), PACK(size, 0));         /* free block header */
+    PUT(FTRP(bp), PACK(size, 0));         /* free block footer */
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
+
+    /* Coalesce if the previous block was free */
+    return coalesce(bp);
+}
+/* $end mmextendheap */
+
+/*
+ * trim - 큰 프리 블록의 메모리를 반납. 힙 끝의 블록이 TRIM_THRESHOLD 이상이면
+ *        CHUNKSIZE 만 남기고 힙을 줄이고, 중간의 블록이 DECOMMIT_THRESHOLD 
+ *        이상이면 내부 페이지 중 [lo, hi) 에 든 것만 반납. 이미 반납된 큰
+ *        이웃을 합칠 때마다 그 페이지를 다시 반납하지 않도록 mm_free 가
+ *        새로 프리된 범위를 넘겨준다
+ */
+static void trim(void *bp, char *lo, char *hi)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *start = (char *)bp + DSIZE;
+    char *end = (char *)bp + size - DSIZE;
+
+    if (GET_SIZE(HDRP(NEXT_BLKP(bp))) != 0) {
+        /* 헤더, 리스트 포인터, 푸터가 있는 페이지는 남김 */
+        if (size >= DECOMMIT_THRESHOLD) {
+            start = (lo > start) ? lo : start;
+            end = (hi < end) ? hi : end;
+            if (start < end) {
+                mem_decommit(start, end - start);
+            }
+        }
+        return;
+    }
+    if (size < TRIM_THRESHOLD) {
+        return;
+    }
+
+    escape(bp);
+    PUT(HDRP(bp), PACK(CHUNKSIZE, 0));
+    PUT(FTRP(bp), PACK(CHUNKSIZE, 0));
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
+    mem_sbrk(-(int)(size - CHUNKSIZE));
+    insert(bp);
+}
+
+/*
+ * place - Place block of asize bytes at start of free block bp
+ *         and split if remainder would be at least minimum block size
+ */
+/* $begin mmplace */
+static void place(void *bp, size_t asize)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+
+    escape(bp);
+    if ((csize - asize) >= DDSIZE) {
+	PUT(HDRP(bp), PACK(asize, 1));
+	PUT(FTRP(bp), PACK(asize, 1));
+	bp = NEXT_BLKP(bp);
+	PUT(HDRP(bp), PACK(csize-asize, 0));
+	PUT(FTRP(bp), PACK(csize-asize, 0));
+        insert(bp);
+    }
+    else {
+	PUT(HDRP(bp), PACK(csize, 1));
+	PUT(FTRP(bp), PACK(csize, 1));
+    }
+}
+/* $end mmplace */
+
+/*
+ * find_fit - Find a free block of at least asize bytes with two bit scans
+ */
+static void *find_fit(size_t asize)
+{
+    size_t fl, sl, sl_map, fl_map;
+
+    mapping_search(asize, &fl, &sl);
+    if (fl >= FL_COUNT)
+        return NULL;
+
+    /* 같은 1단계 안에서 sl 이상인 비어있지 않은 2단계 리스트 */
+    sl_map = SL_BITMAP(fl) & (~(size_t)0 << sl);
+    if (sl_map == 0) {
+        /* 없으면 더 큰 1단계 중 가장 작은 것 */
+        fl_map = FL_BITMAP() & (~(size_t)0 << (fl + 1));
+        if (fl_map == 0)
+            return NULL; /* no fit */
+        fl = FFS(fl_map);
+        sl_map = SL_BITMAP(fl);
+    }
+    sl = FFS(sl_map);
+
+    return GET_HEAD(fl, sl);
+}
+
+/*
+ * coalesce - boundary tag coalescing. Return ptr to coalesced block
+ */
+static void *coalesce(void *bp)
+{
+    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (prev_alloc && next_alloc) {            /* Case 1 */
+    }
+
+    else if (prev_alloc && !next_alloc) {      /* Case 2 */
+	escape(NEXT_BLKP(bp));
+	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+	PUT(HDRP(bp), PACK(size, 0));
+	PUT(FTRP(bp), PACK(size,0));
+    }
+
+    else if (!prev_alloc && next_alloc) {      /* Case 3 */
+	escape(PREV_BLKP(bp));
+	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
+	PUT(FTRP(bp), PACK(size, 0));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+	bp = PREV_BLKP(bp);
+    }
+
+    else {                                     /* Case 4 */
+	escape(NEXT_BLKP(bp));
+	escape(PREV_BLKP(bp));
+	size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
+	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+	bp = PREV_BLKP(bp);
+    }
+
+    insert(bp);
+    return bp;
+}
+
+
+static void printblock(void *bp)
+{
+    size_t hsize, halloc, fsize, falloc;
+
+    hsize = GET_SIZE(HDRP(bp));
+    halloc = GET_ALLOC(HDRP(bp));
+    fsize = GET_SIZE(FTRP(bp));
+    falloc = GET_ALLOC(FTRP(bp));
+
+    if (hsize == 0) {
+	printf("%p: EOL\n", bp);
+	return;
+    }
+
+    printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp,
+	   (int)hsize, (halloc ? 'a' : 'f'),
+	   (int)fsize, (falloc ? 'a' : 'f'));
+}
+
+static void checkblock(void *bp)
+{
+    if ((size_t)bp % ALIGNMENT)
+	printf("Error: %p is not %d-byte aligned\n", bp, ALIGNMENT);
+    if (GET(HDRP(bp)) != GET(FTRP(bp)))
+	printf("Error: header does not match footer\n");
+}
+
+/* Private Functions */
+/*
+ * mapping_insert - 블록 크기가 속하는 (1단계, 2단계) 리스트 번호를 계산
+ */
+static void mapping_insert(size_t size, size_t *fl, size_t *sl)
+{
+    size_t f;
+
+    /* SMALL_BLOCK 보다 작은 크기는 1단계 0 번을 DSIZE 간격으로 나눔 */
+    if (size < SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size / (SMALL_BLOCK / SL_COUNT);
+        return;
+    }
+
+    f = LOG2(size);
+    *sl = (size >> (f - SL_LOG2)) ^ SL_COUNT;
+    *fl = f - FL_SHIFT + 1;
+}
+
+/*
+ * mapping_search - 요청 크기를 다음 2단계 구간으로 올림한 뒤 리스트 번호를 계산.
+ *                  해당 리스트의 모든 블록은 요청 크기 이상이 된다.
+ */
+static void mapping_search(size_t size, size_t *fl, size_t *sl)
+{
+    if (size >= SMALL_BLOCK)
+        size += ((size_t)1 << (LOG2(size) - SL_LOG2)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+/* LIFO */
+/* 프리리스트에 프리 블록을 삽입 시키는 함수 */
+static void insert(void *bp)
+{
+    size_t fl, sl;
+
+    mapping_insert(GET_SIZE(HDRP(bp)), &fl, &sl);
+
+    GET_PREV(bp) = NULL;
+    GET_NEXT(bp) = GET_HEAD(fl, sl);
+    if (GET_HEAD(fl, sl) != NULL) {
+        GET_PREV(GET_HEAD(fl, sl)) = bp;
+    }
+    GET_HEAD(fl, sl) = bp;
+    FL_BITMAP() |= (size_t)1 << fl;
+    SL_BITMAP(fl) |= (size_t)1 << sl;
+}
+
+/* 프리리스트에서 프리 블록을 제외 시키는 함수 */
+static void escape(void *bp)
+{
+    size_t fl, sl;
+
+    mapping_insert(GET_SIZE(HDRP(bp)), &fl, &sl);
+
+    if (GET_NEXT(bp) != NULL) {
+        GET_PREV(GET_NEXT(bp)) = GET_PREV(bp);
+    }
+    if (GET_PREV(bp) != NULL) {
+        GET_NEXT(GET_PREV(bp)) = GET_NEXT(bp);
+        return;
+    }
+
+    /* 리스트의 첫 번째 노드인 경우 헤더를 갱신하고, 리스트가 비면 비트맵을 지움 */
+    GET_HEAD(fl, sl) = GET_NEXT(bp);
+    if (GET_HEAD(fl, sl) == NULL) {
+        SL_BITMAP(fl) &= ~((size_t)1 << sl);
+        if (SL_BITMAP(fl) == 0)
+            FL_BITMAP() &= ~((size_t)1 << fl);
+    }
+}
@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 /*
  * If NEXT_FIT defined use next fit search, else use first fit search 
@@ -48,10 +49,10 @@ team_t team = {
 
 /* $begin mallocmacros */
 /* Basic constants and macros */
-#define WSIZE       4       /* word size (bytes) */  
-#define DSIZE       8       /* doubleword size (bytes) */
+#define WSIZE       (ALIGNMENT/2) /* word size (bytes), 8 in 64-bit builds */  
+#define DSIZE       ALIGNMENT     /* doubleword size (bytes) */
 #define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
-#define OVERHEAD    8       /* overhead of header and footer (bytes) */
+#define OVERHEAD    (2*WSIZE)     /* overhead of header and footer (bytes) */
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))  
 
@@ -314,14 +315,14 @@ static void printblock(void *bp)
     }
 
     printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp, 
-	   hsize, (halloc ? 'a' : 'f'), 
-	   fsize, (falloc ? 'a' : 'f')); 
+	   (int)hsize, (halloc ? 'a' : 'f'), 
+	   (int)fsize, (falloc ? 'a' : 'f')); 
 }
 
 static void checkblock(void *bp) 
 {
-    if ((size_t)bp % 8)
-	printf("Error: %p is not doubleword aligned\n", bp);
+    if ((size_t)bp % ALIGNMENT)
+	printf("Error: %p is not %d-byte aligned\n", bp, ALIGNMENT);
     if (GET(HDRP(bp)) != GET(FTRP(bp)))
 	printf("Error: header does not match footer\n");
 }
@@ -1,9 +1,30 @@
+#ifndef __MM_H_
+#define __MM_H_
+
 #include <stdio.h>
 
+/*
+ * Compiling a package with -DMM_PREFIX=name renames its mm_ functions
+ * and team to name_mm_init, ..., name_team, so that several packages
+ * can be linked into one driver (see mmall.c).
+ */
+#ifdef MM_PREFIX
+#define MM_CAT2(prefix, sym) prefix##_##sym
+#define MM_CAT(prefix, sym)  MM_CAT2(prefix, sym)
+#define mm_init        MM_CAT(MM_PREFIX, mm_init)
+#define mm_malloc      MM_CAT(MM_PREFIX, mm_malloc)
+#define mm_free        MM_CAT(MM_PREFIX, mm_free)
+#define mm_realloc     MM_CAT(MM_PREFIX, mm_realloc)
+#define mm_usable_size MM_CAT(MM_PREFIX, mm_usable_size)
+#define mm_checkheap   MM_CAT(MM_PREFIX, mm_checkheap)
+#define team           MM_CAT(MM_PREFIX, team)
+#endif
+
 extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
+extern size_t mm_usable_size(void *ptr); /* only needed by mmshim.c */
 
 
 /* 
@@ -17,7 +38,9 @@ typedef struct {
     char *id1;      /* login ID of first member */
     char *name2;    /* full name of second member (if any) */
     char *id2;      /* login ID of second member */
+    int thread_safe; /* nonzero if mm_malloc etc. may run on many threads */
 } team_t;
 
 extern team_t team;
 
+#endif /* __MM_H_ */
@@ -0,0 +1,85 @@
+/*
+ * mmall.c - Links every mm package into one driver, mdriver-all.
+ *
+ * Each mm-<name>.c is compiled with -DMM_PREFIX=<name>, which renames
+ * its entry points to <name>_mm_malloc and so on (see mm.h). This file
+ * lists them in mm_packages[] and defines mm_init, mm_malloc, ... and
+ * team for mdriver.c, forwarding to the package picked by mm_select.
+ */
+#include <stddef.h>
+#include <string.h>
+
+#include "mm.h"
+#include "mmall.h"
+
+#define DECLARE(p) \
+    extern team_t p##_team; \
+    extern int p##_mm_init(void); \
+    extern void *p##_mm_malloc(size_t size); \
+    extern void p##_mm_free(void *ptr); \
+    extern void *p##_mm_realloc(void *ptr, size_t size); \
+    extern size_t p##_mm_usable_size(void *ptr);
+
+#define PACKAGE(p) \
+    {#p, &p##_team, p##_mm_init, p##_mm_malloc, p##_mm_free, \
+     p##_mm_realloc, p##_mm_usable_size}
+
+DECLARE(implicit)
+DECLARE(explicit)
+DECLARE(segregate)
+DECLARE(tlsf)
+DECLARE(arena)
+
+/* The first package is the baseline of mdriver-all's comparison */
+mm_package_t mm_packages[] = {
+    PACKAGE(implicit),
+    PACKAGE(explicit),
+    PACKAGE(segregate),
+    PACKAGE(tlsf),
+    PACKAGE(arena),
+    {NULL}
+};
+
+static mm_package_t *current = &mm_packages[0];
+team_t team;
+
+int mm_select(char *name)
+{
+    mm_package_t *p;
+
+    for (p = mm_packages; p->name != NULL; p++)
+	if (!strcmp(p->name, name)) {
+	    current = p;
+	    team = *p->team;
+	    return 0;
+	}
+    return -1;
+}
+
+/*
+ * The mm interface of the selected package
+ */
+int mm_init(void)
+{
+    return current->init();
+}
+
+void *mm_malloc(size_t size)
+{
+    return current->malloc(size);
+}
+
+void mm_free(void *ptr)
+{
+    current->free(ptr);
+}
+
+void *mm_realloc(void *ptr, size_t size)
+{
+    return current->realloc(ptr, size);
+}
+
+size_t mm_usable_size(void *ptr)
+{
+    return current->usable_size(ptr);
+}
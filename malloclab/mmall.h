@@ -0,0 +1,26 @@
+#ifndef __MMALL_H_
+#define __MMALL_H_
+
+/*
+ * mmall.h - the table of mm packages linked into mdriver-all
+ */
+#include "mm.h"
+
+/* One mm package, compiled with -DMM_PREFIX=name */
+typedef struct {
+    char *name;                         /* as given to mdriver -b */
+    team_t *team;
+    int (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    size_t (*usable_size)(void *ptr);
+} mm_package_t;
+
+extern mm_package_t mm_packages[];     /* ends with a NULL name */
+
+/* Make mm_init, mm_malloc, ... and team refer to the package called
+   name, or return -1 if there is none */
+int mm_select(char *name);
+
+#endif /* __MMALL_H_ */
@@ -0,0 +1,394 @@
+/*
+ * mmcapture.c - LD_PRELOAD shim that records the malloc traffic of a
+ *               running program, so it can be replayed by mdriver.
+ *
+ * Build it with "make libmmcapture.so" and run the program as
+ *
+ *	unix> LD_PRELOAD=./libmmcapture.so MMCAPTURE_FILE=app.raw ./app
+ *	unix> cap2rep app.raw app.rep
+ *
+ * Without MMCAPTURE_FILE the log goes to mmcapture.<pid>.raw, which is
+ * also where programs started by the captured one write theirs.
+ *
+ * malloc, calloc, realloc and free pass every call on to the next
+ * definition (normally libc's) found with dlsym(RTLD_NEXT) and log it
+ * as a caprec_t (see capture.h). Each thread appends to a ring of its
+ * own without any lock: the thread is the ring's only producer and the
+ * flusher thread, which writes the rings to the log in the background,
+ * its only consumer. A thread whose ring is full waits for the flusher
+ * rather than drop records, since a lost free would break the trace.
+ * When a thread exits its ring is retired, and the next new thread
+ * takes it over once the flusher has emptied it. Rings are never
+ * unmapped while the flusher may walk them, so there are only ever as
+ * many as the most threads that were alive at once.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "capture.h"
+
+#define RING_SIZE   (1<<16)   /* records in each thread's ring (power of 2) */
+#define FLUSH_NSECS 1000000   /* flusher nap when every ring is empty */
+#define BOOT_SIZE   4096      /* bytes handed out while dlsym runs */
+
+/* States of a ring */
+#define RING_LIVE    0        /* owned by a running thread */
+#define RING_RETIRED 1        /* its thread exited, free to take over */
+
+/* A thread's ring of records; head and tail only ever grow */
+typedef struct ring_t {
+    unsigned head;            /* next record to write, moved by the thread */
+    unsigned tail;            /* next record to flush, moved by the flusher */
+    uint32_t tid;             /* kernel thread id of the owner */
+    int state;                /* RING_LIVE or RING_RETIRED */
+    struct ring_t *next;      /* next ring in the list of all rings */
+    caprec_t recs[RING_SIZE];
+} ring_t;
+
+/* The real allocator */
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static int initializing;      /* set while dlsym looks them up */
+
+static ring_t *rings;         /* every thread's ring, newest first */
+static int capturing;         /* records are taken while this is set */
+static int stopping;          /* tells the flusher to drain and quit */
+static int logfd = -1;        /* the raw log */
+static pthread_t flusher;
+static pthread_key_t ring_key; /* retires a thread's ring when it exits */
+
+/* dlsym may itself call calloc before real_calloc is known */
+static char boot[BOOT_SIZE];
+static size_t boot_used;
+
+/* initial-exec so touching them never calls malloc */
+static __thread ring_t *my_ring __attribute__((tls_model("initial-exec")));
+static __thread int in_shim __attribute__((tls_model("initial-exec")));
+
+#define IN_BOOT(p) ((char *)(p) >= boot && (char *)(p) < boot + BOOT_SIZE)
+
+/*
+ * init_real - Look up the real allocator
+ */
+static void init_real(void)
+{
+    initializing = 1;
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    initializing = 0;
+}
+
+/*
+ * boot_alloc - Hand out zeroed memory that is never given back
+ */
+static void *boot_alloc(size_t size)
+{
+    void *p;
+
+    size = (size + 15) & ~(size_t)15;
+    if (boot_used + size > BOOT_SIZE)
+	return NULL;
+    p = boot + boot_used;
+    boot_used += size;
+    return p;
+}
+
+/*
+ * write_all - write(2) that retries short writes
+ */
+static void write_all(const void *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+	if ((n = write(logfd, buf, len)) <= 0)
+	    return;
+	buf = (const char *)buf + n;
+	len -= n;
+    }
+}
+
+/*
+ * reuse_ring - Take over a retired ring the flusher has emptied, or
+ *    return NULL if there is none
+ */
+static ring_t *reuse_ring(void)
+{
+    ring_t *r;
+    int retired;
+
+    for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL; r = r->next) {
+	retired = RING_RETIRED;
+	if ((__atomic_load_n(&r->state, __ATOMIC_ACQUIRE) == RING_RETIRED) &&
+	    (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == r->head) &&
+	    __atomic_compare_exchange_n(&r->state, &retired, RING_LIVE, 0,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	    return r;
+    }
+    return NULL;
+}
+
+/*
+ * new_ring - Get a ring for the calling thread, reusing a retired one
+ *    if it can, or else mapping one and adding it to the list
+ */
+static ring_t *new_ring(void)
+{
+    ring_t *r;
+
+    if ((r = reuse_ring()) == NULL) {
+	r = mmap(NULL, sizeof(ring_t), PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (r == MAP_FAILED)
+	    return NULL;
+	r->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&rings, &r->next, r, 1,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+	    ;
+    }
+    r->tid = (uint32_t)syscall(SYS_gettid);
+    pthread_setspecific(ring_key, r);
+    return r;
+}
+
+/*
+ * retire_ring - Destructor of ring_key: give the ring of an exiting
+ *    thread up for reuse once the flusher has emptied it
+ */
+static void retire_ring(void *arg)
+{
+    ring_t *r = arg;
+
+    my_ring = NULL;
+    __atomic_store_n(&r->state, RING_RETIRED, __ATOMIC_RELEASE);
+}
+
+/*
+ * record - Append a record to the calling thread's ring
+ */
+static void record(uint32_t type, void *ptr, void *result, size_t size)
+{
+    ring_t *r;
+    caprec_t *rec;
+    struct timespec ts;
+
+    if (!capturing || in_shim)
+	return;
+    in_shim = 1;
+    if ((r = my_ring) == NULL && (r = my_ring = new_ring()) == NULL) {
+	in_shim = 0;
+	return;
+    }
+
+    /* Wait for the flusher while the ring is full */
+    while (r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+	if (!capturing) {
+	    in_shim = 0;
+	    return;
+	}
+	sched_yield();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    rec = &r->recs[r->head & (RING_SIZE - 1)];
+    rec->ts = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    rec->ptr = (uintptr_t)ptr;
+    rec->result = (uintptr_t)result;
+    rec->size = size;
+    rec->tid = r->tid;
+    rec->type = type;
+    __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+    in_shim = 0;
+}
+
+/*
+ * drain - Write out every record waiting in ring r and return how many
+ */
+static unsigned drain(ring_t *r)
+{
+    unsigned head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    unsigned tail = r->tail;
+    unsigned start = tail & (RING_SIZE - 1);
+    unsigned n = head - tail;
+
+    if (n == 0)
+	return 0;
+    if (start + n > RING_SIZE) {   /* wraps around the end of the ring */
+	write_all(&r->recs[start], (RING_SIZE - start) * sizeof(caprec_t));
+	write_all(&r->recs[0], (start + n - RING_SIZE) * sizeof(caprec_t));
+    }
+    else
+	write_all(&r->recs[start], n * sizeof(caprec_t));
+    __atomic_store_n(&r->tail, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+/*
+ * flush_rings - Body of the flusher thread
+ */
+static void *flush_rings(void *arg)
+{
+    ring_t *r;
+    unsigned n;
+    int stop;
+    struct timespec nap = {0, FLUSH_NSECS};
+
+    in_shim = 1; /* the flusher's own calls are not part of the program */
+    for (;;) {
+	stop = __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+	n = 0;
+	for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL; r = r->next)
+	    n += drain(r);
+	if (n == 0) {
+	    if (stop)
+		break;
+	    nanosleep(&nap, NULL);
+	}
+    }
+    return NULL;
+}
+
+/*
+ * capture_child - A forked child has no flusher, so it logs nothing
+ *    and has no use for the rings it inherited
+ */
+static void capture_child(void)
+{
+    ring_t *r, *next;
+
+    capturing = 0;
+    logfd = -1;
+    for (r = rings; r != NULL; r = next) {
+	next = r->next;
+	munmap(r, sizeof(ring_t));
+    }
+    rings = NULL;
+    my_ring = NULL;
+    pthread_setspecific(ring_key, NULL);
+}
+
+/*
+ * capture_init - Open the log and start the flusher before main runs
+ */
+static void __attribute__((constructor)) capture_init(void)
+{
+    char path[64];
+    const char *name;
+    caphdr_t hdr = {CAP_MAGIC, CAP_VERSION};
+
+    if (real_malloc == NULL)
+	init_real();
+    if ((name = getenv("MMCAPTURE_FILE")) == NULL) {
+	snprintf(path, sizeof(path), "mmcapture.%d.raw", (int)getpid());
+	name = path;
+    }
+    if ((logfd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+	perror("mmcapture: open");
+	return;
+    }
+    unsetenv("MMCAPTURE_FILE"); /* so exec'd children don't clobber it */
+    write_all(&hdr, sizeof(hdr));
+
+    in_shim = 1;
+    if ((pthread_key_create(&ring_key, retire_ring) != 0) ||
+	(pthread_create(&flusher, NULL, flush_rings, NULL) != 0)) {
+	fprintf(stderr, "mmcapture: could not start the flusher\n");
+	close(logfd);
+	logfd = -1;
+	in_shim = 0;
+	return;
+    }
+    pthread_atfork(NULL, NULL, capture_child);
+    in_shim = 0;
+    __atomic_store_n(&capturing, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * capture_fini - Stop taking records and flush what is left
+ */
+static void __attribute__((destructor)) capture_fini(void)
+{
+    if (logfd < 0)
+	return;
+    __atomic_store_n(&capturing, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(flusher, NULL);
+    close(logfd);
+    logfd = -1;
+}
+
+/*
+ * The interposed allocator. Allocations are recorded after the real
+ * call and frees before it (see capture.h).
+ */
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (real_malloc == NULL) {
+	if (initializing)
+	    return boot_alloc(size);
+	init_real();
+    }
+    p = real_malloc(size);
+    record(CAP_MALLOC, NULL, p, size);
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (real_calloc == NULL) {
+	if (initializing)
+	    return boot_alloc(nmemb * size);
+	init_real();
+    }
+    p = real_calloc(nmemb, size);
+    record(CAP_CALLOC, NULL, p, nmemb * size);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+    size_t len;
+
+    if (IN_BOOT(ptr)) {
+	/* Move a boot block into the real heap; boot is never reused */
+	if ((p = malloc(size)) != NULL) {
+	    len = boot + BOOT_SIZE - (char *)ptr;
+	    memcpy(p, ptr, (size < len) ? size : len);
+	}
+	return p;
+    }
+    if (real_realloc == NULL)
+	init_real();
+    p = real_realloc(ptr, size);
+    record(CAP_REALLOC, ptr, p, size);
+    return p;
+}
+
+void free(void *ptr)
+{
+    if ((ptr == NULL) || IN_BOOT(ptr))
+	return;
+    if (real_free == NULL)
+	init_real();
+    record(CAP_FREE, ptr, NULL, 0);
+    real_free(ptr);
+}
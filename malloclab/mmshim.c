@@ -0,0 +1,405 @@
+/*
+ * mmshim.c - Exports an mm package as the malloc of a real program,
+ *            so it can be benchmarked with LD_PRELOAD instead of only
+ *            on the driver's traces.
+ *
+ *	unix> make libmm-segregate.so
+ *	unix> LD_PRELOAD=./libmm-segregate.so ./app
+ *
+ * The heap is memlib's mmap'd reservation of MMSHIM_HEAP_MB megabytes
+ * (SHIM_HEAP_MB by default), set up on the first call. Only mm-arena.c
+ * is thread-safe, so every call into the package holds one lock unless
+ * the library is built with -DSHIM_NOLOCK.
+ *
+ * Alignments above ALIGNMENT are served by allocating alignment extra
+ * bytes and sliding the payload up to the next aligned address. The
+ * aligned[] table, under a lock of its own, maps such a payload back
+ * to its block for free.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+#if !USE_MMAP_HEAP
+#error "mmshim.c needs the mmap'd heap (USE_MMAP_HEAP in config.h)"
+#endif
+
+#define SHIM_HEAP_MB 256  /* default heap reservation (MB) */
+#define ALIGNED_BITS 6    /* log2 of the initial aligned[] size */
+
+/* The packages keep sizes that fit the heap, which never grows past
+   MAX_HEAP_LIMIT, so larger requests fail here before reaching them */
+#define TOO_BIG(size) ((size) > MAX_HEAP_LIMIT)
+
+/* A payload slid up for alignment, and the block it lives in */
+typedef struct {
+    char *ptr;            /* aligned payload, or NULL if the slot is empty */
+    char *block;          /* block returned by mm_malloc */
+} aligned_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int initialized;
+/* set while this thread is inside the package; initial-exec never mallocs */
+static __thread int in_mm __attribute__((tls_model("initial-exec")));
+
+static pthread_mutex_t aligned_lock = PTHREAD_MUTEX_INITIALIZER;
+static aligned_t *aligned; /* open addressing table of aligned payloads */
+static int aligned_bits;
+static unsigned naligned;
+
+/*
+ * setup - Reserve the heap and initialize the package, once
+ */
+static void setup(void)
+{
+    char *env;
+    size_t mb = SHIM_HEAP_MB;
+
+    pthread_mutex_lock(&lock);
+    if (!initialized) {
+	if ((env = getenv("MMSHIM_HEAP_MB")) != NULL)
+	    mb = strtoul(env, NULL, 10);
+	if (mem_setmax(mb << 20) < 0)
+	    mem_setmax((size_t)SHIM_HEAP_MB << 20);
+	mem_init();
+	if (mm_init() < 0)
+	    abort();
+	__atomic_store_n(&initialized, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * enter - Take the lock before calling into the package. Returns 0 if
+ *    the package is already busy on this thread (it called back into
+ *    malloc, e.g. through stdio), in which case the call fails.
+ */
+static int enter(void)
+{
+    if (in_mm)
+	return 0;
+    in_mm = 1;
+    if (!__atomic_load_n(&initialized, __ATOMIC_ACQUIRE))
+	setup();
+#ifndef SHIM_NOLOCK
+    pthread_mutex_lock(&lock);
+#endif
+    return 1;
+}
+
+static void leave(void)
+{
+#ifndef SHIM_NOLOCK
+    pthread_mutex_unlock(&lock);
+#endif
+    in_mm = 0;
+}
+
+/* Home slot of an aligned payload: Fibonacci hashing keeps the top bits */
+#define ALIGNED_HOME(p) \
+    ((unsigned)(((uint64_t)(uintptr_t)(p) * 0x9e3779b97f4a7c15ull) >> (64 - aligned_bits)))
+
+static aligned_t *aligned_find(void *ptr)
+{
+    unsigned mask = (1u << aligned_bits) - 1, i;
+
+    if (naligned == 0)
+	return NULL;
+    for (i = ALIGNED_HOME(ptr); aligned[i].ptr != NULL; i = (i + 1) & mask)
+	if (aligned[i].ptr == ptr)
+	    return &aligned[i];
+    return NULL;
+}
+
+static int aligned_insert(char *ptr, char *block)
+{
+    aligned_t *old = aligned;
+    unsigned i, mask, n = aligned ? (1u << aligned_bits) : 0;
+    int bits;
+
+    if (4 * (naligned + 1) > 3 * n) {   /* double once 3/4 full */
+	bits = n ? aligned_bits + 1 : ALIGNED_BITS;
+	if ((aligned = mm_malloc(sizeof(aligned_t) << bits)) == NULL) {
+	    aligned = old;
+	    return -1;
+	}
+	memset(aligned, 0, sizeof(aligned_t) << bits);
+	aligned_bits = bits;
+	naligned = 0;
+	for (i = 0; i < n; i++)
+	    if (old[i].ptr != NULL)
+		aligned_insert(old[i].ptr, old[i].block);
+	if (old != NULL)
+	    mm_free(old);
+    }
+    mask = (1u << aligned_bits) - 1;
+    for (i = ALIGNED_HOME(ptr); aligned[i].ptr != NULL; i = (i + 1) & mask)
+	;
+    aligned[i].ptr = ptr;
+    aligned[i].block = block;
+    naligned++;
+    return 0;
+}
+
+/* Backward-shift deletion, as in mdriver's idmap_remove */
+static void aligned_remove(aligned_t *slot)
+{
+    unsigned mask = (1u << aligned_bits) - 1;
+    unsigned i = slot - aligned, j, home;
+
+    for (j = (i + 1) & mask; aligned[j].ptr != NULL; j = (j + 1) & mask) {
+	home = ALIGNED_HOME(aligned[j].ptr);
+	if (((j - home) & mask) >= ((j - i) & mask)) {
+	    aligned[i] = aligned[j];
+	    i = j;
+	}
+    }
+    aligned[i].ptr = NULL;
+    naligned--;
+}
+
+/*
+ * aligned_block - Return the block of a payload slid up for alignment,
+ *    dropping it from the table if remove is set, or NULL if ptr is a
+ *    plain payload
+ */
+static char *aligned_block(void *ptr, int remove)
+{
+    aligned_t *slot;
+    char *block = NULL;
+
+    if (__atomic_load_n(&naligned, __ATOMIC_RELAXED) == 0)
+	return NULL;
+    pthread_mutex_lock(&aligned_lock);
+    if ((slot = aligned_find(ptr)) != NULL) {
+	block = slot->block;
+	if (remove)
+	    aligned_remove(slot);
+    }
+    pthread_mutex_unlock(&aligned_lock);
+    return block;
+}
+
+/*
+ * shim_free - Free a payload, between enter() and leave()
+ */
+static void shim_free(void *ptr)
+{
+    char *block;
+
+    /* Blocks from outside the heap and its mapped regions (none are
+       expected) are leaked */
+    if ((((char *)ptr < (char *)mem_heap_lo()) || ((char *)ptr > (char *)mem_heap_hi())) &&
+	!mem_mapped(ptr, ptr))
+	return;
+    if ((block = aligned_block(ptr, 1)) != NULL)
+	ptr = block;
+    mm_free(ptr);
+}
+
+/*
+ * shim_usable - Usable bytes of a payload, between enter() and leave()
+ */
+static size_t shim_usable(void *ptr)
+{
+    char *block;
+
+    if ((block = aligned_block(ptr, 0)) != NULL)
+	return mm_usable_size(block) - ((char *)ptr - block);
+    return mm_usable_size(ptr);
+}
+
+/*
+ * shim_memalign - Allocate size bytes aligned to alignment (a power of
+ *    two), between enter() and leave()
+ */
+static void *shim_memalign(size_t alignment, size_t size)
+{
+    char *block, *ptr;
+    int err = 0;
+
+    if (TOO_BIG(size) || TOO_BIG(alignment) || TOO_BIG(size + alignment))
+	return NULL;
+    if (alignment <= ALIGNMENT)
+	return mm_malloc(size ? size : 1);
+    if ((block = mm_malloc(size + alignment)) == NULL)
+	return NULL;
+    ptr = (char *)(((uintptr_t)block + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (ptr != block) {
+	pthread_mutex_lock(&aligned_lock);
+	err = aligned_insert(ptr, block);
+	pthread_mutex_unlock(&aligned_lock);
+    }
+    if (err < 0) {
+	mm_free(block);
+	return NULL;
+    }
+    return ptr;
+}
+
+/*
+ * The exported allocator
+ */
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (TOO_BIG(size) || !enter()) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    p = mm_malloc(size ? size : 1);   /* malloc(0) must be unique */
+    leave();
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+void free(void *ptr)
+{
+    if ((ptr == NULL) || !enter())
+	return;
+    shim_free(ptr);
+    leave();
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (((size != 0) && (nmemb > SIZE_MAX / size)) || TOO_BIG(nmemb * size) || !enter()) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    /* Not malloc + memset, which gcc would turn back into calloc */
+    p = mm_malloc((nmemb * size != 0) ? nmemb * size : 1);
+    leave();
+    if (p == NULL)
+	errno = ENOMEM;
+    else
+	memset(p, 0, nmemb * size);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+    size_t usable;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if (size == 0) {
+	free(ptr);
+	return NULL;
+    }
+    if (TOO_BIG(size) || !enter()) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    if (aligned_block(ptr, 0) == NULL)
+	p = mm_realloc(ptr, size);
+    else if ((p = mm_malloc(size)) != NULL) {
+	/* The package does not know the slid payload, so move it here */
+	usable = shim_usable(ptr);
+	memcpy(p, ptr, (size < usable) ? size : usable);
+	shim_free(ptr);
+    }
+    leave();
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *p;
+
+    if ((alignment < sizeof(void *)) || (alignment & (alignment - 1)))
+	return EINVAL;
+    if (!enter())
+	return ENOMEM;
+    p = shim_memalign(alignment, size);
+    leave();
+    if (p == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *p;
+
+    if (alignment & (alignment - 1)) {
+	errno = EINVAL;
+	return NULL;
+    }
+    if (!enter()) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    p = shim_memalign(alignment, size);
+    leave();
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+void *valloc(size_t size)
+{
+    return memalign(sysconf(_SC_PAGESIZE), size);
+}
+
+void *pvalloc(size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    return memalign(page, (size + page - 1) & ~(page - 1));
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    size_t n;
+
+    if ((ptr == NULL) || !enter())
+	return 0;
+    n = shim_usable(ptr);
+    leave();
+    return n;
+}
+
+/*
+ * Keep the shim consistent across fork: hold its locks while the
+ * process is copied, then release them in both parent and child.
+ * Packages with locks of their own (mm-arena.c) register their fork
+ * handlers before this one, so theirs are taken after ours, in the
+ * same order as on the malloc path.
+ */
+static void shim_prepare(void)
+{
+    pthread_mutex_lock(&lock);
+    pthread_mutex_lock(&aligned_lock);
+}
+
+static void shim_release(void)
+{
+    pthread_mutex_unlock(&aligned_lock);
+    pthread_mutex_unlock(&lock);
+}
+
+static void __attribute__((constructor)) shim_init(void)
+{
+    pthread_atfork(shim_prepare, shim_release, shim_release);
+}
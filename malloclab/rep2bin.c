@@ -0,0 +1,97 @@
+/*
+ * rep2bin.c - Convert a text tracefile (.rep) into the binary
+ *             tracefile format of trace.h, which mdriver maps and
+ *             decodes without parsing any text.
+ *
+ * Usage: rep2bin <in.rep> <out>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define MAXLINE 1024 /* max string size */
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: rep2bin <in.rep> <out>\n");
+    exit(1);
+}
+
+static void error(char *msg, char *path)
+{
+    fprintf(stderr, "rep2bin: %s %s\n", msg, path);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in, *out;
+    tracehdr_t hdr;
+    char type[MAXLINE];
+    unsigned char rec[TREC_MAX_BYTES], *p;
+    unsigned index, size;
+    int sugg_heapsize, num_ids, num_ops, weight;
+    unsigned op_index = 0;
+
+    if (argc != 3)
+	usage();
+    if ((in = fopen(argv[1], "r")) == NULL)
+	error("could not open", argv[1]);
+    if ((out = fopen(argv[2], "wb")) == NULL)
+	error("could not create", argv[2]);
+
+    /* Same four header lines as read_trace expects */
+    if (fscanf(in, "%d %d %d %d",
+	       &sugg_heapsize, &num_ids, &num_ops, &weight) != 4)
+	error("bad header in", argv[1]);
+    if ((num_ids < 0) || (num_ids - 1 > TREC_MAX_INDEX) || (num_ops < 0))
+	error("too many ids or ops in", argv[1]);
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = TRACE_MAGIC;
+    hdr.version = TRACE_VERSION;
+    hdr.sugg_heapsize = sugg_heapsize;
+    hdr.num_ids = num_ids;
+    hdr.num_ops = num_ops;
+    hdr.weight = weight;
+
+    /* The header is written again once data_bytes is known */
+    fwrite(&hdr, sizeof(hdr), 1, out);
+    while (fscanf(in, "%s", type) != EOF) {
+	size = 0;
+	switch (type[0]) {
+	case 'a':
+	case 'r':
+	    if (fscanf(in, "%u %u", &index, &size) != 2)
+		error("bad request in", argv[1]);
+	    break;
+	case 'f':
+	    if (fscanf(in, "%u", &index) != 1)
+		error("bad request in", argv[1]);
+	    break;
+	default:
+	    error("bogus type character in", argv[1]);
+	}
+	if (index >= (unsigned)num_ids)
+	    error("id out of range in", argv[1]);
+
+	p = put_varint(rec, (index << 2) | ((type[0] == 'a') ? TREC_ALLOC :
+					     (type[0] == 'f') ? TREC_FREE :
+					     TREC_REALLOC));
+	if (type[0] != 'f')
+	    p = put_varint(p, size);
+	fwrite(rec, 1, p - rec, out);
+	hdr.data_bytes += p - rec;
+	op_index++;
+    }
+    if (op_index != (unsigned)num_ops)
+	error("request count does not match header in", argv[1]);
+
+    rewind(out);
+    fwrite(&hdr, sizeof(hdr), 1, out);
+    if (fclose(out) != 0)
+	error("could not write", argv[2]);
+    fclose(in);
+    return 0;
+}
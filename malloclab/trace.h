@@ -0,0 +1,73 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+/*
+ * trace.h - binary tracefile format shared by mdriver and rep2bin
+ *
+ * A binary tracefile is a fixed tracehdr_t followed by num_ops packed
+ * records. Each record starts with a varint holding (index << 2 | type),
+ * and alloc and realloc records follow it with a varint byte size.
+ * Varints are unsigned LEB128: 7 bits per byte, low bits first, the
+ * high bit set on every byte but the last. Header fields are stored
+ * in host byte order.
+ */
+#include <stdint.h>
+
+#define TRACE_MAGIC   0x42544c4d  /* "MLTB" */
+#define TRACE_VERSION 1
+
+/* Record types, in the same order as the driver's request types */
+#define TREC_ALLOC   0
+#define TREC_FREE    1
+#define TREC_REALLOC 2
+
+#define TREC_MAX_INDEX ((1u << 30) - 1) /* largest id that fits a record */
+#define TREC_MAX_BYTES 10               /* two 5-byte varints */
+
+typedef struct {
+    uint32_t magic;          /* TRACE_MAGIC */
+    uint32_t version;        /* TRACE_VERSION */
+    uint32_t sugg_heapsize;  /* same four fields as a .rep header */
+    uint32_t num_ids;
+    uint32_t num_ops;
+    uint32_t weight;
+    uint64_t data_bytes;     /* bytes of packed records after the header */
+} tracehdr_t;
+
+/*
+ * put_varint - Store v at p and return the byte after it
+ */
+static inline unsigned char *put_varint(unsigned char *p, uint32_t v)
+{
+    while (v >= 0x80) {
+	*p++ = (unsigned char)(v | 0x80);
+	v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+/*
+ * get_varint - Load a varint at p into *v and return the byte after it,
+ *    or NULL if it runs past end or does not fit 32 bits.
+ */
+static inline const unsigned char *get_varint(const unsigned char *p,
+					      const unsigned char *end,
+					      uint32_t *v)
+{
+    uint32_t x = 0;
+    int shift;
+
+    for (shift = 0; (p < end) && (shift < 35); shift += 7) {
+	if ((shift == 28) && (*p & 0x70))
+	    return NULL; /* only the low 4 bits of the 5th byte fit */
+	x |= (uint32_t)(*p & 0x7f) << shift;
+	if ((*p++ & 0x80) == 0) {
+	    *v = x;
+	    return p;
+	}
+    }
+    return NULL;
+}
+
+#endif /* __TRACE_H_ */